@@ -13,12 +13,15 @@
 
 
 /*
- * RS232 COMMANDS:
+ * RS232 COMMANDS: (command table in command.c, "help" lists them)
  *
  * 1) battery temps
  * 2) battery volts
  * 3) battery current
  * 4) battery state
+ * 5) help
+ * 6) stream on [n] / stream off	(binary telemetry, see stream.h)
+ * 7) task stats / task reset		(scheduler timing, see sched.h)
  */
 
 #include <stdio.h>
@@ -33,22 +36,28 @@
 #include "ad7739_func.h"
 #include "LTC6803.h"
 #include "can.h"
+#include "ixcheck.h"
+#include "limits.h"
+#include "command.h"
+#include "stream.h"
+#include "sched.h"
+#include "relay.h"
+#include "probe.h"
+#include "trip.h"
+#include "mode.h"
+#include "precharge.h"
+#include "i2t.h"
+#include "soc.h"
+#include "rcell.h"
+#include "trise.h"
+#include "packv.h"
+#include "zero.h"
 
 
-#define MAX_TEMP_DISCHARGE 		0x003476b9 		//59 Degree C
-#define MAX_TEMP_CHARGE   		0x0042bbff		//45 Degree C
-#define MIN_TEMP_NOSENSOR  		0x006244b5		//Therm not connected
-// Computed from data sheet +/-1%
-//0x337a7d is 60 deg (140 F)
-//0x3476b9 is 59 deg (131 F)
-//0x388c06 is 55 deg (131 F)
-//0x42bbff is 45 deg (113 F)
-//0x54b605 is 25 deg ( 77 F)
-//0x6244b5 is  0 deg ( 32 F)
-//0x6942ef is Therm not connected
-
 #define MAX_CURRENT_DISCHARGE	+80200.0		//80.0A    @ 2.45 volts across batt shunt
 #define MAX_CURRENT_CHARGE		-19500.0		//-19.5A @ .62 volts across batt shunt
+#define TRIP_OC_SEVERE_DIV		4				//over-current 25 % past the limit trips in one sample
+#define TRIP_OT_SEVERE			332000UL		//thermistor codes, ~5 degree C past the limit (0x388c06 - 0x337a7d)
 
 //LTC Variables
 volatile unsigned char ltc1_errflag = 0x00;		//set if LTC1 error
@@ -57,15 +66,16 @@ volatile unsigned char ltc3_errflag = 0x00; 	//set if LTC3 error
 unsigned char ltc_error = 0;					//combined error calc
 volatile unsigned char batt1,batt2,batt3;		//stores return value of flag read
 volatile unsigned char sc_batt_error;			// self check status error
-volatile unsigned char status_flag = FALSE;		//status flag set on timer B
 volatile unsigned char batt_KILL = FALSE;		//set to isolate batt
 volatile unsigned char batt_ERR = 0x00 ;		//Cause of batt_KILL
 volatile unsigned char capture_err = 0x00 ;		//Cause of batt_KILL
 volatile unsigned char int_op1_flag = 0x00;		//interrupt operational flags
 volatile unsigned char int_op2_flag = 0x00;		//interrupt operational flags
+volatile unsigned int tick_count = 0;			//timer B ticks since reset (wraps)
 
-int mode_count = 0;								//used for sequencing
-int mode_dwell_count = 0;						//used for sequencing
+int mode_count = 0;								//used for LTC sequencing
+unsigned char ltc_sweep = FALSE;				//set when mode_count completes a sweep of all three LTCs
+unsigned char ltc_sweep_err = 0x00;				//status and read errors of that sweep
 unsigned int ltc1_cv[12];						//holds ltc1 cell volts
 unsigned int ltc2_cv[12];						//holds ltc2 cell volts
 unsigned int ltc3_cv[12];						//holds ltc3 cell volts
@@ -75,7 +85,6 @@ volatile unsigned long temperature_adc[40];		//stores adc temperatures
 volatile unsigned char ch;						//used for ch switching of adc
 volatile unsigned char dev;						//used for dev switching of
 volatile unsigned char i;						//used for counting
-volatile unsigned char temp_flag = FALSE;		//used for temp measurement timing
 //ADC Current Variables
 volatile long diff_ref, diff_shunt, current_dvolt;
 float current;					//keeps track of current direction across batt shunt
@@ -83,7 +92,6 @@ float current;					//keeps track of current direction across batt shunt
 // CAN Communication Variables
 volatile unsigned char send_can = FALSE;	//used for CAN transmission timing
 volatile unsigned char can_full = FALSE;	//used for CAN transmission status
-volatile unsigned char cancomm_flag = FALSE;	//used for CAN transmission timing
 volatile unsigned char ac_charge_mode = FALSE;	//used for CAN transmission
 volatile unsigned char dc_charge_mode = FALSE;	//used for CAN transmission
 volatile unsigned char charge_mode = 0x00;	//used for CAN transmission
@@ -96,7 +104,6 @@ volatile float 	min_voltage;
 volatile long	max_temp_val;
 volatile int	max_temp_idx;
 volatile unsigned char comms_event_count = 0;
-volatile unsigned int can_err_cnt = 0x0000;
 volatile int cancheck_flag;
 volatile unsigned char 	can_CANINTF, can_FLAGS[3];
 
@@ -113,1107 +120,1374 @@ volatile long AC_Serial_No;
 unsigned long SIG1;								//measures BATT voltage
 unsigned long SIG2;								//measures precharge shunt resistor voltage
 unsigned long SIG3;								//measures voltage after MC contactor
-unsigned long compare_sig;						//stores signal comparison value
 volatile char PC_Complete = FALSE;				//TRUE when caps are charged
 volatile char MC_Complete = FALSE;				//TRUE when MC contactor is closed
 
 //RS232 Variables
-char command[32];								//stores rs232 commands
-char buff[32];									//buff array to hold sprintf string
-unsigned char rs232_count = 0;					//counts characters received
-char batt_temp[32] = "battery temps\r";			//command to read batt temperatures
 char batt_temp_status = 0;						//TRUE if battery temps is sent
-char batt_volt[32] = "battery volts\r";			//command to read cell volts
 char batt_volt_status = 0;						//TRUE if battery volts is sent
-char batt_current[32] ="battery current\r";		//command to read battery current
 char batt_current_status = 0;					//TRUE if battery current is sent
-char batt_state[32] ="battery state\r";		//command to read battery current
-char batt_state_status = 0;					//TRUE if battery current is sent
-float volt;										//variable to store adc volt conv
+char batt_state_status = 0;					//TRUE if battery state is sent
 float temp;										//temperature calculation
 float max_temp;
-int temp1;										//integer value
-int temp2;										//tenths place
-int temp3;										//hundredths place
 
 unsigned int err_mode_cnt = 7*4;
 
+//Startup timing
+unsigned long init_us = 0;						//last init_hw, us
+unsigned long boot_us = 0;						//reset to the end of the first init_hw, us
+unsigned char adc_cal_late = 0x00;				//ADCn_RDY bits of ADCs that missed the self cal timeout
+unsigned char ltc_init_err = 0x00;				//LTCs whose config did not read back (0x01 LTC1 .. 0x04 LTC3)
+
+enum MODE
+{
+	INITIALIZE,
+	SELFCHECK,
+	BPSREADY,
+	ARRAYREADY,
+	CANCHECK,
+	PRECHARGE,
+	NORMALOP,
+	CHARGE,
+	ERRORMODE
+};
+volatile unsigned char bpsMODE = INITIALIZE;		//enum MODE, changed only by mode.c
+
+// Task functions, run by the scheduler
+static void task_measure(void);
+static void task_ltc(void);
+static void task_can(void);
+static void task_limits(void);
+static void task_comms(void);
+static void task_pc(void);
+static void task_probe(void);
+static void task_mode(void);
+static void probe_frame(void);
+static void rcell_frame(void);
+static void trise_frame(void);
+static void packv_frame(void);
+static long shunt_read(void);
+
+// Mode hooks, guards and actions, run by mode_step
+static void init_entry(void);
+static unsigned char init_ready(void);
+static void init_hw(void);
+static void init_measure(void);
+static void selfcheck_entry(void);
+static void selfcheck_exit(void);
+static unsigned char selfcheck_pass(void);
+static unsigned char selfcheck_fail(void);
+static void selfcheck_retry(void);
+static void bpsready_during(void);
+static void arrayready_during(void);
+static unsigned char dc_charge_req(void);
+static unsigned char ac_charge_req(void);
+static void dc_charge_start(void);
+static void ac_charge_start(void);
+static unsigned char precharge_req(void);
+static void precharge_ack(void);
+static void precharge_entry(void);
+static void precharge_during(void);
+static unsigned char mc_ready(void);
+static void mc_close(void);
+static void charge_entry(void);
+static void charge_exit(void);
+static unsigned char charge_ended(void);
+static void error_entry(void);
+static void mode_blink(void);
+static void precharge_sample(void);
+static unsigned char ltc_status_level(unsigned char ltc, unsigned char status);
+
+/*
+ * Task table, the index is the task id used with sched_release
+ *	- Safety checks (current, temperature, cell voltage) have the lowest priority numbers
+ *	  and always start ahead of CAN telemetry and RS232
+ */
+enum TASK
+{
+	TASK_MEASURE,
+	TASK_LTC,
+	TASK_MODE,
+	TASK_CAN,
+	TASK_LIMITS,
+	TASK_COMMS,
+	TASK_PC,
+	TASK_PROBE
+};
+
+static sched_task tasks[] =
+{
+	// name		handler			period					deadline				priority
+	{ "measure",	task_measure,	LTC_STATUS_COUNT/2,		LTC_STATUS_COUNT/2,		0 },	// current and temperature limits
+	{ "ltc",		task_ltc,		LTC_STATUS_COUNT,		LTC_STATUS_COUNT,		1 },	// cell voltages, mode sequence
+	{ "mode",		task_mode,		1,						1,						2 },	// mode transitions, every tick
+	{ "can",		task_can,		1,						CAN_RX_DEADLINE,		3 },	// also released by CAN_INTn
+	{ "limits",		task_limits,	LIMITS_COMMS_COUNT,		LIMITS_COMMS_COUNT,		4 },
+	{ "comms",		task_comms,		CAN_COMMS_COUNT,		CAN_COMMS_COUNT,		5 },
+	{ "pc",			task_pc,		PC_TASK_COUNT,			PC_TASK_COUNT,			6 },	// also released by RS232 RX
+	{ "probe",		task_probe,		PROBE_CAN_COUNT,		PROBE_CAN_COUNT,		7 },	// one BP_PROBE frame
+};
+
+/*
+ * BPS modes, the index is the enum MODE value
+ *	- DR LED code is mode + 1, ERRORMODE shows the fault code instead
+ */
+static const mode_state bps_modes[] =
+{
+	// name			led		entry				during				exit
+	{ "init",		0x1,	init_entry,			0,					0 },
+	{ "selfcheck",	0x2,	selfcheck_entry,	0,					selfcheck_exit },
+	{ "bpsready",	0x3,	0,					bpsready_during,	0 },
+	{ "arrayready",	0x4,	0,					arrayready_during,	0 },
+	{ "cancheck",	0x5,	0,					0,					0 },
+	{ "precharge",	0x6,	precharge_entry,	precharge_during,	0 },
+	{ "normalop",	0x7,	0,					mode_blink,			0 },
+	{ "charge",		0x8,	charge_entry,		mode_blink,			charge_exit },
+	{ "error",		0x0,	error_entry,		0,					0 },
+};
+
+/*
+ * Mode transitions, first match in table order wins
+ *	- ERRORMODE is entered by mode_force on batt_KILL, INITIALIZE and CHARGE also by the buttons
+ */
+static const mode_transition bps_transitions[] =
+{
+	// from			to				dwell (ms)			guard				action
+	{ INITIALIZE,	SELFCHECK,		0,					init_ready,			init_hw },
+	{ SELFCHECK,	SELFCHECK,		0,					selfcheck_fail,		selfcheck_retry },
+	{ SELFCHECK,	BPSREADY,		0,					selfcheck_pass,		0 },
+	{ BPSREADY,		ARRAYREADY,		MODE_READY_MS,		0,					0 },
+	{ ARRAYREADY,	CANCHECK,		MODE_READY_MS,		0,					0 },
+	{ CANCHECK,		CHARGE,			MODE_CANCHECK_MS,	dc_charge_req,		dc_charge_start },
+	{ CANCHECK,		CHARGE,			MODE_CANCHECK_MS,	ac_charge_req,		ac_charge_start },
+	{ CANCHECK,		PRECHARGE,		MODE_CANCHECK_MS,	precharge_req,		precharge_ack },
+	{ PRECHARGE,	NORMALOP,		0,					mc_ready,			mc_close },
+	{ CHARGE,		CANCHECK,		0,					charge_ended,		0 },
+};
+
 /*=================================== **MAIN** =========================================*/
 //////////////////////////////////////////////////////////////////////////////////////////
 
 int main(void)
 {
-	unsigned int i;
-
-	enum MODE
-	{
-		INITIALIZE,
-		SELFCHECK,
-		BPSREADY,
-		ARRAYREADY,
-		CANCHECK,
-		PRECHARGE,
-		NORMALOP,
-		CHARGE,
-		ERRORMODE
-	}bpsMODE;
-
 	WDTCTL = WDTPW | WDTHOLD | WDTSSEL__ACLK; 	// Stop watchdog timer to prevent time out reset
 	_DINT();     		    					//disables interrupts
 
-	//open all relays
-	relay_mcpc_open;
-	ext_relay_mcpc_open;
-	relay_mc_open;
-	delay();
-	relay_batt_open;
-	delay();
-	relay_array_open;
+	relay_init();								//open all relays
 
 	bps_strobe_off;
 
-	bpsMODE = INITIALIZE;
-	DR_LED0_ON;								//INIT LED ON
-
 	io_init();									//enable IO pins
 	clock_init();								//Configure HF and LF clocks
 	timerB_init();								//init timer B
+	probe_init();								//1 MHz timestamp for the execution time probes
+	soc_init();									//state of charge from info flash
+	zero_init();								//shunt zero offsets from info flash
+	rcell_init();								//cell resistance estimates from the prior
+	LTC_cal_load();								//cell voltage calibration from info flash
 	
 	BPS2PC_init();								//init RS232
 	canspi_init();
 	can_init();
 
-	status_flag = TRUE;
+	sched_init(tasks, sizeof(tasks) / sizeof(tasks[0]));
+	mode_init(&bpsMODE, bps_modes, sizeof(bps_modes) / sizeof(bps_modes[0]),
+			  bps_transitions, sizeof(bps_transitions) / sizeof(bps_transitions[0]), INITIALIZE);
+	sched_release(TASK_MODE);					//run INITIALIZE straight away
 
 	while(TRUE)								//loop forever
 	{
-		if(status_flag)
+		if(!sched_run())						//most urgent released task, if any
 		{
-			status_flag = FALSE;
-			mode_count++;
-			mode_dwell_count++;
-			batt_KILL = FALSE;
-			batt_ERR = 0x00;
+			sched_idle();						//nothing due, LPM0 until the next interrupt
+		}
 
-			if(bpsMODE == INITIALIZE)
-			{
-				WDTCTL = WDTPW | WDTHOLD | WDTSSEL__ACLK; 	// Stop watchdog timer to prevent time out reset
-				_DINT();     		    					//disables interrupts
-
-				//open all relays
-				relay_mcpc_open;
-				ext_relay_mcpc_open;
-				relay_mc_open;
-				delay();
-				relay_batt_open;
-				delay();
-				relay_array_open;
-
-				bps_strobe_off;
-
-				send_can = FALSE;
-
-				DR_LED0_ON;								//INIT LED ON
-
-				BPS2PC_init();								//init RS232
-				canspi_init();
-				can_init();
-
-				//adc bus1 initializations
-				adc_bus1_spi_init();
-				adc_bus1_init();
-				adc_bus1_selfcal(1);
-				adc_bus1_read_convert(0,1);
-				adc_bus1_selfcal(2);
-				adc_bus1_read_convert(0,2);
-				adc_bus1_selfcal(3);
-				adc_bus1_read_convert(0,3);
-				//adc bus2 initializations
-				adc_bus2_spi_init();
-				adc_bus2_init();
-				adc_bus2_selfcal(1);
-				adc_bus2_read_convert(0,1);
-				adc_bus2_selfcal(2);
-				adc_bus2_read_convert(0,2);
-				adc_bus2_selfcal(3);
-				adc_bus2_read_convert(0,3);
-				//adc misc initializations
-				adc_misc_spi_init();
-				adc_misc_init();
-				adc_misc_selfcal();
-				adc_misc_read_convert(0);
-
-				i = 50000;									// SW Delay
-				do i--;
-				while (i != 0);
-				// Uncertain why these are each done twice ... bjb
-				//LTC1 Configure
-				LTC1_init();
-				LTC1_init();
-				ltc1_errflag = 0x00;
-				//LTC2 Configure
-				LTC2_init();
-				LTC2_init();
-				ltc2_errflag = 0x00;
-				//LTC3 Configure
-				LTC3_init();
-				LTC3_init();
-				ltc3_errflag = 0x00;
-				
-				bpsMODE = SELFCHECK;
-				mode_dwell_count = 0;
-				DR_LED0_OFF;
-				DR_LED1_ON;
-
-				mode_count = 0;
-				mode_dwell_count = 0;
-
-			    /*Enable Interrupts*/
-				UCA3IE |= UCRXIE;			//RS232 receive interrupt
-				WDTCTL = WDT_ARST_1000; 	// Stop watchdog timer to prevent time out reset
-				__bis_SR_register(GIE); 	//enable global interrupts
-				__no_operation();			//for compiler
+		// BUTTON1 Press Received   
+		if(((P1IN & BUTTON1) != BUTTON1) || ((int_op1_flag & 0x08) == 0x08))
+		{
+			int_op1_flag &= 0x08;
 
-			}
-			else if(bpsMODE == ERRORMODE)
-			{
-				//look for CAN message to end errormode
-				err_mode_cnt--;
-				if(err_mode_cnt ==0x00)
-				{
-					bps_strobe_tog;
-					err_mode_cnt = 7*4;
-				}
+		   	charge_mode |= 0x10;
+			mode_force(CHARGE);					//opens MC and precharge relays
+		}
 
-			}
-			else	//normal periodic sequence based on mode_count
-			{
-				//batt1 status - O/U voltage
-				batt1 = LTC1_Read_Config();
-				batt1 |= LTC1_Read_Flags();
-				if((batt1 != 0x00) && (bpsMODE != SELFCHECK) )
-				{
-					batt_KILL = TRUE;
-					batt_ERR = 0x11;
-					batt1=0x00;
-				}
-				//batt2 status - O/U voltage
-				batt2 = LTC2_Read_Config();
-				batt2 |= LTC2_Read_Flags();
-				if((batt2 != 0x00) && (bpsMODE != SELFCHECK) )
-				{
-					batt_KILL = TRUE;
-					batt_ERR = 0x12;
-					batt2=0x00;
-				}
-				//batt3 status - O/U voltage
-				batt3 = LTC3_Read_Config();
-				batt3 |= LTC3_Read_Flags();
-				if((batt3 != 0x00) && (bpsMODE != SELFCHECK) )
-				{
-					batt_KILL = TRUE;
-					batt_ERR = 0x13;
-					batt3=0x00;
-				}
-				sc_batt_error = batt1 | batt2 |batt3;
+		// BUTTON2 Press Received   
+		if(((P1IN & BUTTON2) != BUTTON2) || ((int_op1_flag & 0x04) == 0x04))
+		{
+			int_op1_flag &= 0x04;
 
-				// Periodic Measurements
-				switch(mode_count)
-				{
-					case 1:
-					  ltc1_errflag = 0x00;
-					  ltc2_errflag = 0x00;
-					  ltc3_errflag = 0x00;
-					break;
-					case 2:
-					  LTC1_Start_ADCCV();
-					break;
-					case 3:
-					  batt1 = LTC1_Read_Voltages();
-					  if (batt1 != 0x00)
-					  {
-						ltc1_errflag = TRUE;
-					  }
-					break;
-					case 4:
-					  LTC2_Start_ADCCV();
-					break;
-					case 5:
-					  batt2 = LTC2_Read_Voltages();
-					  if (batt2 != 0x00)
-					  {
-						 ltc2_errflag = TRUE;
-					  }
-					break;
-					case 6:
-					 LTC3_Start_ADCCV();
-					break;
-					case 7:
-					  batt3 = LTC3_Read_Voltages();
-					  if (batt3 != 0x00)
-					  {
-						  ltc3_errflag = TRUE;
-					  }
-					break;
-					case 8:
-						asm(" nop");
-					break;
-					default:
-					  mode_count = 0;
-					break;
-				}	// END Switch mode_count
+			mode_force(INITIALIZE);				//open all relays, battery and array follow
+		}
 
-				ltc_error = ltc1_errflag | ltc2_errflag | ltc3_errflag;
+		//handle batt_KILL error
 
-				if (ltc_error != 0x00 && (bpsMODE != SELFCHECK))
-				{
-					batt_KILL = TRUE; // LTC Error
-					batt_ERR = 0x20;
-					ltc_error = FALSE;
-				}
-				if (mode_count == 0x08)
-				{
-					mode_count = 0;
+		if(batt_KILL)
+		{
+			relay_open_all();					//already started by bps_trip, battery and array follow
+			mode_force(ERRORMODE);				//indicators set on entry, once per fault
+			batt_KILL = FALSE;
+		}
+		else
+		{
+			LED_ERROR_OFF;
+		}
+		WDTCTL = WDT_ARST_1000; // Stop watchdog timer to prevent time out reset
 
-					switch(bpsMODE)
-					{
-					case SELFCHECK:
-						if(sc_batt_error || ltc_error)
-						{
-							batt_KILL = FALSE;
-							batt_ERR = 0x00;
-							//reset  batt_KILL
-							LED_NORMALOP_OFF;									//LED NORMALOP OFF
-							char i;
-							for(i = 0; i < 2; i++)								//re-init ltcs reset flags
-							{
-								LTC1_init();
-								LTC2_init();
-								LTC3_init();
-								ltc1_errflag = 0x00;
-								ltc2_errflag = 0x00;
-								ltc3_errflag = 0x00;
-							}
-							//adc bus1 initializations							//re-init adcs and calibrate
-							adc_bus1_spi_init();
-							adc_bus1_init();
-							adc_bus1_selfcal(1);
-							adc_bus1_read_convert(0,1);
-							adc_bus1_selfcal(2);
-							adc_bus1_read_convert(0,2);
-							adc_bus1_selfcal(3);
-							adc_bus1_read_convert(0,3);
-							//adc bus2 initializations
-							adc_bus2_spi_init();
-							adc_bus2_init();
-							adc_bus2_selfcal(1);
-							adc_bus2_read_convert(0,1);
-							adc_bus2_selfcal(2);
-							adc_bus2_read_convert(0,2);
-							adc_bus2_selfcal(3);
-							adc_bus2_read_convert(0,3);
-							//adc misc initializations
-							adc_misc_spi_init();
-							adc_misc_init();
-							adc_misc_selfcal();
-							adc_misc_read_convert(0);
-						}
-						else
-						{
-							bpsMODE = BPSREADY;
-							mode_dwell_count = 0;
-							P6OUT &= ~(LED3|LED2);		//DR LED 0x3
-							P6OUT |=  (LED5|LED4);		//
-							LED_ERROR_OFF;
-							// canspi_init();
-							// can_init();
-						}
-					break;
+	} //end while(TRUE)
 
-					case BPSREADY:
-						relay_batt_close;		//BPS Power Enabled
-						if(mode_dwell_count>=16)
-						{
-							bpsMODE = ARRAYREADY;
-							mode_dwell_count = 0;
-							P6OUT &= ~(LED4);				//DR LED 0x4
-							P6OUT |=  (LED5|LED3|LED2);		//
-						}
+}
+/*================================ ** END MAIN** =========================================*/
+////////////////////////////////////////////////////////////////////////////////////////////
 
-					break;
+/*
+ * Cell voltage task, every LTC_STATUS_COUNT ticks
+ *	- mode_count sequences the LTC conversions, a full sweep is 8 runs
+ */
+static void task_ltc(void)
+{
+	unsigned long t_sample;
+	unsigned char cv_err = 0xFF;			//voltage read result this run, 0xFF = no read
+	unsigned char pv_level;
 
-					case ARRAYREADY:
-						relay_array_close;		//Array Connection Enabled
-						send_can = TRUE;		//Start CAN transmissions
-						if(mode_dwell_count>=16)
-						{
-							bpsMODE = CANCHECK;
-							mode_dwell_count = 0;
-							P6OUT &= ~(LED4|LED2);		//DR LED 0x5
-							P6OUT |=  (LED5|LED3);		//
+	mode_count++;
+	batt_KILL = FALSE;
+	batt_ERR = 0x00;
 
-						}
+	if(bpsMODE == INITIALIZE)
+	{
+		//LTCs and ADCs are set up by init_hw on the way out of INITIALIZE
+	}
+	else if(bpsMODE == ERRORMODE)
+	{
+		//look for CAN message to end errormode
+		err_mode_cnt--;
+		if(err_mode_cnt ==0x00)
+		{
+			bps_strobe_tog;
+			err_mode_cnt = 7*4;
+		}
 
-					break;
+	}
+	else	//normal periodic sequence based on mode_count
+	{
+		t_sample = probe_time();			//LTC flags and voltages read from here
 
-					case CANCHECK:
-						//check for CAN message start PRECHARGE
-						// If array controller in charge mode
-						// If driver controller in charge mode
-						// enter the CHARGE operational mode
-
-						if(mode_dwell_count>=16)
-						{
-							if(dc_charge_mode)
-							{
-								relay_mcpc_open;
-								relay_mc_open;
-								ext_relay_mcpc_open;
-								charge_mode |= 0x01;
-								bpsMODE = CHARGE;
-								mode_dwell_count = 0;
-								P6OUT &= ~(LED5);		//DR LED 0x8
-								P6OUT |=  (LED4|LED3|LED2);		//
-
-							}
-							else if(ac_charge_mode)
-							{
-								relay_mcpc_open;
-								relay_mc_open;
-								ext_relay_mcpc_open;
-								charge_mode |= 0x02;
-								bpsMODE = CHARGE;
-								mode_dwell_count = 0;
-								P6OUT &= ~(LED5);		//DR LED 0x8
-								P6OUT |=  (LED4|LED3|LED2);		//
-
-							}
-							else if ((can_start_precharge) || (can_car_enable))
-							{
-								can_start_precharge = FALSE;
-								relay_mcpc_close;										//close MCPC contactor
-								ext_relay_mcpc_close;									//close external pc relay to read signals
-								bpsMODE = PRECHARGE;
-								LED_ERROR_TOG;
-								mode_dwell_count = 0;
-								P6OUT &= ~(LED4|LED3);		//DR LED 0x6
-								P6OUT |=  (LED5|LED2);		//
-							}
-							mode_dwell_count = 0;
-						}
-					break;
+		//batt1 status - O/U voltage
+		batt1 = LTC1_Read_Config();
+		batt1 |= LTC1_Read_Flags();
+		if(bpsMODE != SELFCHECK)
+		{
+			trip_sample(TRIP_LTC1, ltc_status_level(0, batt1), 0x11, t_sample);
+		}
+		//batt2 status - O/U voltage
+		batt2 = LTC2_Read_Config();
+		batt2 |= LTC2_Read_Flags();
+		if(bpsMODE != SELFCHECK)
+		{
+			trip_sample(TRIP_LTC2, ltc_status_level(1, batt2), 0x12, t_sample);
+		}
+		//batt3 status - O/U voltage
+		batt3 = LTC3_Read_Config();
+		batt3 |= LTC3_Read_Flags();
+		if(bpsMODE != SELFCHECK)
+		{
+			trip_sample(TRIP_LTC3, ltc_status_level(2, batt3), 0x13, t_sample);
+		}
+		sc_batt_error = batt1 | batt2 |batt3;
 
-					case CHARGE:
-						//check for CAN message start PRECHARGE
-						// If array controller in charge more
-						// If driver controller in charge mode
-						// Insure precharge and motor controller
-
-						switch(charge_mode)
-						{
-							case 0x10:
-								LED_NORMALOP_TOG;
-							break;
-							case 0x01:
-								if (dc_charge_mode)
-								{
-									LED_NORMALOP_TOG;
-								}
-								else
-								{
-									bpsMODE = CANCHECK;
-									mode_dwell_count = 0;
-									P6OUT &= ~(LED4|LED2);		//DR LED 0x5
-									P6OUT |=  (LED5|LED3);		//
-									PC_Complete = FALSE;
-									MC_Complete = FALSE;
-									charge_mode = 0x00;
-								}
-							break;
-							case 0x02:
-								if (ac_charge_mode)
-								{
-									LED_NORMALOP_TOG;
-								}
-								else
-								{
-									bpsMODE = CANCHECK;
-									mode_dwell_count = 0;
-									P6OUT &= ~(LED4|LED2);		//DR LED 0x5
-									P6OUT |=  (LED5|LED3);		//
-									PC_Complete = FALSE;
-									MC_Complete = FALSE;
-									charge_mode = 0x00;
-								}
-							break;
-
-						}
-					break;
+		// Periodic Measurements
+		switch(mode_count)
+		{
+			case 1:
+			  ltc1_errflag = 0x00;
+			  ltc2_errflag = 0x00;
+			  ltc3_errflag = 0x00;
+			break;
+			case 2:
+			  LTC1_Start_ADCCV();
+			  rcell_sync(0, shunt_read());		//current during the conversion
+			break;
+			case 3:
+			  cv_err = LTC1_Read_Voltages();
+			  if (cv_err != 0x00)
+			  {
+				ltc1_errflag |= cv_err;		//PEC bit, TRUE would read as LTC_ERR_UV
+			  }
+			  else
+			  {
+				rcell_update(0);				//dV against dI since the last good read
+			  }
+			break;
+			case 4:
+			  LTC2_Start_ADCCV();
+			  rcell_sync(1, shunt_read());
+			break;
+			case 5:
+			  cv_err = LTC2_Read_Voltages();
+			  if (cv_err != 0x00)
+			  {
+				 ltc2_errflag |= cv_err;
+			  }
+			  else
+			  {
+				 rcell_update(1);
+			  }
+			break;
+			case 6:
+			 LTC3_Start_ADCCV();
+			 rcell_sync(2, shunt_read());
+			break;
+			case 7:
+			  cv_err = LTC3_Read_Voltages();
+			  if (cv_err != 0x00)
+			  {
+				  ltc3_errflag |= cv_err;
+			  }
+			  else
+			  {
+				  rcell_update(2);
+			  }
+			break;
+			case 8:
+				pack_stats_update();		//all three LTCs read, update min/max
+				if(bpsMODE != PRECHARGE)	//precharge_sample reads it every tick in PRECHARGE
+				{
+					adc_misc_contconv_start(5);							//battery signal (SIGNAL 1)
+					SIG1 = adc_misc_read_convert(5);
+				}
+				pv_level = packv_check(SIG1, shunt_read());	//cell sum against SIG1
+				if(bpsMODE != SELFCHECK)
+				{
+					trip_sample(TRIP_PACKV, pv_level, 0x80, t_sample);
+				}
+			break;
+			default:
+			  mode_count = 0;
+			break;
+		}	// END Switch mode_count
 
-					case PRECHARGE:
-						//start cont conv for PC signals
-						adc_misc_contconv_start(5);								//battery signal 			(SIGNAL 1)
-						adc_misc_contconv_start(6);								//precharge resistor signal (SIGNAL 2)
-						adc_misc_contconv_start(7);								//motor contactor signal    (SIGNAL 3)
-
-						SIG1 = adc_misc_read_convert(5);
-						SIG2 = adc_misc_read_convert(6);
-						SIG3 = adc_misc_read_convert(7);
-
-						if(mode_dwell_count>=32)
-						{
-
-						if(PC_Complete == FALSE)								//if caps are not charged
-						{
-							//wait for valid reading SIG1 92.4 to 147 V
-							// R Divider ~0.01525	--> 0x00E5C1D5 to 0x00906B35
-							//
-							if (SIG1 > 0x00900000)
-							{
-								compare_sig = abs(SIG1 - SIG2);					//compare SIG1 & SIG2
-
-								if(compare_sig < 0x040000 && SIG2 > 0x00800000)	//check comparison is small and SIG2 is not noise
-								{
-									PC_Complete = TRUE;
-								}
-								else
-								{
-									PC_Complete = FALSE;
-								}
-							}
-						}
-						else if(MC_Complete == FALSE && PC_Complete == TRUE)	//only run loop when PC_Complete = TRUE
-						{
-							if (SIG2 > 0x00900000)
-							{				//wait for valid reading SIG1
-								compare_sig = abs(SIG2 - SIG3);					//compare SIG1 and SIG2
-
-								if(compare_sig < 0x040000 && SIG3 > 0x00800000)	//ensure motor contactor is closed
-								{
-									MC_Complete = TRUE;
-								//PC is complete at this point
-									relay_mc_close;				  				//close MC contactor
-									ext_relay_mcpc_open;						//open external PC relay
-									relay_mcpc_open;			  				//open MCPC contactor
-									bpsMODE = NORMALOP;
-									LED_ERROR_TOG;
-									mode_dwell_count = 0;
-									P6OUT &= ~(LED4|LED3|LED2);		//DR LED 0x7
-									P6OUT |=  (LED5);		//
-
-									// Transmit Precharge CAN Message
-									can.address = BP_CAN_BASE + BP_PCDONE;
-									can.data.data_u8[7] = 'B';
-									can.data.data_u8[6] = 'P';
-									can.data.data_u8[5] = 'v';
-									can.data.data_u8[4] = '1';
-									can.data.data_u32[0] = DEVICE_SERIAL;
-									cancheck_flag=can_transmit();
-									if(cancheck_flag == 1) can_init();
-								}
-								else
-								{
-									MC_Complete = FALSE;
-								}
-							}
-
-						}
-						}
-					break;
+		ltc_error = ltc1_errflag | ltc2_errflag | ltc3_errflag;
 
-					case NORMALOP:
-						LED_NORMALOP_TOG;
-					break;
+		if ((cv_err != 0xFF) && (bpsMODE != SELFCHECK))	// LTC Error, one sample per voltage read
+		{
+			trip_sample(TRIP_LTC_READ, (cv_err != 0x00) ? TRIP_MARGINAL : TRIP_OK, 0x20, t_sample);
+		}
+		if (mode_count == 0x08)
+		{
+			mode_count = 0;
+			ltc_sweep_err = sc_batt_error | ltc_error;
+			ltc_sweep = TRUE;				//for the SELFCHECK guards
+		}
 
-					}//end switch(bpsMODE)
+	}//end else
+}
 
-				}//end if(mode_count == 0x08)
+/*
+ * Filter level of an LTC config + flags read: an OV flag trips at once, UV,
+ * PEC and config readback errors need confirming
+ *	- A UV flag alone is dropped when the IR drop under load explains it
+ */
+static unsigned char ltc_status_level(unsigned char ltc, unsigned char status)
+{
+	if(status & LTC_ERR_OV) return(TRIP_SEVERE);
+	if((status == LTC_ERR_UV) && rcell_uv_ok(ltc)) return(TRIP_OK);
+	return((status != 0x00) ? TRIP_MARGINAL : TRIP_OK);
+}
 
-			}//end else
+/*
+ * Mode transitions, every tick
+ */
+static void task_mode(void)
+{
+	mode_step();
+}
 
-		}//end if(status_flag)
+/*
+ * INITIALIZE: all relays open, no CAN until the hardware is set up again
+ */
+static void init_entry(void)
+{
+	trip_filter_reset();
+	relay_open_all();
+	bps_strobe_off;
+	send_can = FALSE;
+}
 
+/*
+ * Interrupts go off in init_hw, so let the open sequence finish first
+ */
+static unsigned char init_ready(void)
+{
+	return(!relay_busy());
+}
 
-		//////////////////////////CHECK ADC TEMP LIMITS//////////////////////////////////////////
-		if(temp_flag)
-		{
-			temp_flag = FALSE;
+/*
+ * Sets up the ports, ADCs and LTCs, leaves interrupts enabled
+ *	- Timed with probe_time, which stays valid with interrupts off while it is
+ *	  read at least once per Timer A0 wrap (65 ms), as the ADC calibration waits do
+ */
+static void init_hw(void)
+{
+	unsigned long t_start;
 
-			//start adc battery temp continuous conversions
-			for(dev = 1; dev < 4; dev++)								//device {1:3}
-			{
-				for(ch = 0; ch < 8; ch++)								//channel {0:7}
-				{
-					adc_bus1_contconv_start(ch,dev);
-					adc_bus2_contconv_start(ch,dev);
-				}
-			}
+	t_start = probe_time();
+	WDTCTL = WDTPW | WDTHOLD | WDTSSEL__ACLK; 	// Stop watchdog timer to prevent time out reset
+	_DINT();     		    					//disables interrupts
 
-			//start continuous conversion for shunt measurement
-			adc_misc_contconv_start(4);
-			adc_misc_contconv_start(1);
-			//start continous conversion for misc temperatures
-			adc_misc_contconv_start(2);
-			adc_misc_contconv_start(3);
+	bps_strobe_off;
 
-			if(bpsMODE !=SELFCHECK)
-			{
-			///////////////BATTERY TEMPS
-			//read adc bus1 device 1 temperatures
-			for(i = 1; i < 8; i++)
-			{
-				temperature_adc[8-i] = adc_bus1_read_convert(i,1);		//store temp {1:7}
-			}
-			//read adc bus1 device 2 temperatures
-			for(i = 1; i < 8; i++)
-			{
-				temperature_adc[15-i] = adc_bus1_read_convert(i,2);		//store temp {8:14}
-			}
-			//read adc bus1 device 3 temperatures
-			for(i = 1; i < 8; i++)
-			{
-				temperature_adc[22-i] = adc_bus1_read_convert(i,3);		//store temp {15:21}
-			}
-			//read adc bus2 device 1 temperatures
-			for(i = 1; i < 8; i++)
-			{
-				temperature_adc[29-i] = adc_bus2_read_convert(i,1);		//store temp {22:28}
-			}
-			//read adc bus2 device 2 temperatures
-			for(i = 1; i < 8; i++)
-			{
-				temperature_adc[36-i] = adc_bus2_read_convert(i,2);		//store temp {29:35}
-			}
+	send_can = FALSE;
 
-			///////////ADDITIONAL TEMPS
-			temperature_adc[36] = adc_bus2_read_convert(7,3);			//store inlet temp  {36}
-			temperature_adc[37] = adc_bus2_read_convert(6,3);			//store outlet temp {37}
+	BPS2PC_init();								//init RS232
+	canspi_init();
+	can_init();
 
-			temperature_adc[38] = adc_misc_read_convert(3);				//store misc temp 	{38}
-			temperature_adc[39] = adc_misc_read_convert(2);				//store misc temp 	{39}
+	init_measure();
 
-			for(i = 3; i < 40; i++)								//check temperature cells {1:35}
-			{
-				if(temperature_adc[i] >= MIN_TEMP_NOSENSOR)	//temp max is 60 degree C discharging
-				{
-					batt_KILL = TRUE;
-					batt_ERR = 0x60; 	// Broken Temp Sensor
+	init_us = probe_time() - t_start;
+	if(boot_us == 0) boot_us = probe_time();	//Timer A0 starts in main, interrupts first go on below
 
-				}
-			}
+	/*Enable Interrupts*/
+	UCA3IE |= UCRXIE;			//RS232 receive interrupt
+	WDTCTL = WDT_ARST_1000; 	// Stop watchdog timer to prevent time out reset
+	__bis_SR_register(GIE); 	//enable global interrupts
+	__no_operation();			//for compiler
+}
 
-			/////////CHECK LIMITS
+/*
+ * LTCs and ADCs, the three LTC ports and the three ADC buses come up together
+ *	- LTC configurations are written first and read back last, they settle
+ *	  while the ADCs calibrate
+ *	- All seven ADCs calibrate at once, adc_selfcal_all
+ */
+static void init_measure(void)
+{
+	LTC_start_all();
+
+	adc_bus1_spi_init();
+	adc_bus2_spi_init();
+	adc_misc_spi_init();
+	adc_bus1_init();
+	adc_bus2_init();
+	adc_misc_init();
+	adc_cal_late = adc_selfcal_all();
+	adc_bus1_read_convert(0,1);
+	adc_bus1_read_convert(0,2);
+	adc_bus1_read_convert(0,3);
+	adc_bus2_read_convert(0,1);
+	adc_bus2_read_convert(0,2);
+	adc_bus2_read_convert(0,3);
+	adc_misc_read_convert(0);
+
+	ltc_init_err = LTC_verify_all();			//single config write, checked by readback
+	ltc1_errflag = 0x00;
+	ltc2_errflag = 0x00;
+	ltc3_errflag = 0x00;
+}
 
-			//get current direction across batt shunt
-			for(i = 5; i > 0; i--)
-			{
-				diff_ref = adc_misc_read_convert(1);						//check multiple times to avoid invalid data
-				diff_shunt = adc_misc_read_convert(4);						//check multiple times to avoid invalid data
-			}
+/*
+ * SELFCHECK passes on the first clean LTC sweep started after entry
+ */
+static void selfcheck_entry(void)
+{
+	mode_count = 0;
+	ltc_sweep = FALSE;
+}
 
-			current_dvolt = diff_shunt - diff_ref;
+static void selfcheck_exit(void)
+{
+	LED_ERROR_OFF;
+}
 
-			current = (float)(current_dvolt) * CURRENT_I_SCALE;
-			current /= CURRENT_FULL_SCALE;			// in mA
+static unsigned char selfcheck_pass(void)
+{
+	return(ltc_sweep && (ltc_sweep_err == 0x00));
+}
 
-			//check temperature and current limits if discharging
-			if(current >= 0)								//adc > ref  (DISCHARGING)
-			{
-				if(current >= MAX_CURRENT_DISCHARGE)					//over current check
-				{
-					batt_KILL = TRUE;
-					batt_ERR = 0x30; 			// Max Current Discharge
-				}
-				else
-				{
-					for(i = 1; i < 36; i++)								//check temperature cells {1:35}
-					{
-						if(temperature_adc[i] <= MAX_TEMP_DISCHARGE)	//temp max is 60 degree C discharging
-						{
-							batt_KILL = TRUE;
-							batt_ERR = 0x50;	// MAX temperature discharge
-						}
-					}
-				}
-			}
+static unsigned char selfcheck_fail(void)
+{
+	return(ltc_sweep && (ltc_sweep_err != 0x00));
+}
 
-			//check temperature and current limitsbattery current if charging
-			else if(current < 0)									//adc < ref (CHARGING)
-			{
-				if(current <= MAX_CURRENT_CHARGE)						//over current check
-				{
-					batt_KILL = TRUE;
-					batt_ERR = 0x40;		// Max Current Charge
+/*
+ * Re-inits the LTCs and ADCs and starts another sweep
+ */
+static void selfcheck_retry(void)
+{
+	batt_KILL = FALSE;
+	batt_ERR = 0x00;
+	//reset  batt_KILL
+	LED_NORMALOP_OFF;									//LED NORMALOP OFF
+	init_measure();										//re-init ltcs and adcs, calibrate
+	mode_count = 0;
+	ltc_sweep = FALSE;
+}
 
-				}
-				else
-				{
-					for(i = 1; i < 36; i++)								//check temperature cells {1:35}
-					{
-						if(temperature_adc[i] <= MAX_TEMP_CHARGE)		//temp max is 45 degree C charging
-						{
-							batt_KILL = TRUE;
-							batt_ERR = 0x50;	// MAX temperature charge
-						}
-					}
-				}
-			}
-			}
-		}
-	   ////////////////////////////////////////////////////////////////////////////////////////////////
+static void bpsready_during(void)
+{
+	relay_close(RLY_BATT);		//BPS Power Enabled
+}
 
-		/////////////////////////////////////////HANDLE CAN//////////////////////////////////////////
+static void arrayready_during(void)
+{
+	relay_close(RLY_ARRAY);		//Array Connection Enabled
+	send_can = TRUE;			//Start CAN transmissions
+}
 
-		// Handle communications events
-		if (cancomm_flag && send_can)
-		{
-			cancomm_flag = FALSE;
+/*
+ * CANCHECK: array or driver controller charge mode enters CHARGE, a precharge or
+ * car enable message enters PRECHARGE
+ */
+static unsigned char dc_charge_req(void)
+{
+	return(dc_charge_mode);
+}
 
-		// Max Cell Voltage and total battery voltage
-			max_v_cell = 0;
-			ltc_max = 0x0000;
-			bat_voltage = 0x00000000;
-			for(i=0;i<=10;i++)
-			{
-				if((ltc1_cv[i])>ltc_max)
-				{
-					ltc_max=ltc1_cv[i];
-					max_v_cell = i;
-				}
-				bat_voltage += (long) (ltc1_cv[i]-512);
-			}
-			for(i=0;i<=11;i++)
-			{
-				if((ltc2_cv[i])>ltc_max)
-				{
-					ltc_max=ltc2_cv[i];
-					max_v_cell = i+11;
-				}
-				bat_voltage += (long) (ltc2_cv[i]-512);
-			}
-			for(i=0;i<=11;i++)
-			{
-				if((ltc3_cv[i])>ltc_max)
-				{
-					ltc_max=ltc3_cv[i];
-					max_v_cell = i+23;
-				}
-				bat_voltage += (long) (ltc3_cv[i]-512);
-			}
+static unsigned char ac_charge_req(void)
+{
+	return(ac_charge_mode);
+}
 
-			max_voltage = ((float) (ltc_max-512)) * 0.0015;
+static void dc_charge_start(void)
+{
+	charge_mode |= 0x01;
+}
 
-		// Min Cell Voltage
-			min_v_cell = 0;
-			ltc_min = 0x0FFF;
-			for(i=0;i<=10;i++)
-			{
-				if((ltc1_cv[i])<ltc_min)
-				{
-					ltc_min=ltc1_cv[i];
-					min_v_cell = i;
-				}
-			}
-			for(i=0;i<=11;i++)
-			{
-				if((ltc2_cv[i])<ltc_min)
-				{
-					ltc_min=ltc2_cv[i];
-					min_v_cell = i+11;
-				}
-			}
-			for(i=0;i<=11;i++)
-			{
-				if((ltc3_cv[i])<ltc_min)
-				{
-					ltc_min=ltc3_cv[i];
-					min_v_cell = i+23;
-				}
-			}
+static void ac_charge_start(void)
+{
+	charge_mode |= 0x02;
+}
 
-			min_voltage = ((float) (ltc_min-512)) * 0.0015;
+static unsigned char precharge_req(void)
+{
+	return(can_start_precharge || can_car_enable);
+}
 
-		// Max Cell Temperature Already Computed
-			max_temp_val = 0x00FFFFFF;
-			max_temp_idx = 0x0000;
-			for(i = 39; i > 0; i--)
-			{
-				if(temperature_adc[i]<max_temp_val)
-				{
-					max_temp_val = temperature_adc[i];
-					max_temp_idx = i;
-				}
-			}
+static void precharge_ack(void)
+{
+	can_start_precharge = FALSE;
+}
 
-			temp = ((float) max_temp_val / 16777216.0); // voltage ratio
-			max_temp = 126.1575-311.329*temp;  // Linear Est. of Temp 20 - 45
-
-		// Transmit CAN message
-		// Transmit Max Cell Voltage
-			can.address = BP_CAN_BASE + BP_VMAX;
-			can.data.data_fp[1] = max_voltage;
-			can.data.data_fp[0] = (float) max_v_cell;
-			can_transmit();
-
-		// Transmit Min Cell Voltage
-			can.address = BP_CAN_BASE + BP_VMIN;
-			can.data.data_fp[1] = min_voltage;
-			can.data.data_fp[0] = (float) min_v_cell;
-			can_transmit();
-
-		// Transmit Max Cell Temperature
-			can.address = BP_CAN_BASE + BP_TMAX;
-			can.data.data_fp[1] = max_temp;
-			can.data.data_fp[0] = (float) max_temp_idx;
-			can_transmit();
-
-		// Transmit Shunt Cutrrent
-			can.address = BP_CAN_BASE + BP_ISH;
-			can.data.data_fp[1] = current;
-			can.data.data_fp[0] = (float) max_voltage * 0.0015;
-			can_transmit();
-
-		// Transmit our ID frame at a slower rate (every 10 events = 1/second)
-			comms_event_count++;
-			if(comms_event_count >=10)
-			{
-				comms_event_count = 0;
-				can.address = BP_CAN_BASE;
-				can.data.data_u8[7] = 'B';
-				can.data.data_u8[6] = 'P';
-				can.data.data_u8[5] = 'v';
-				can.data.data_u8[4] = '1';
-				can.data.data_u32[0] = DEVICE_SERIAL;
-				cancheck_flag = can_transmit();
-				if(cancheck_flag == 1) can_init();
-			}
+static void precharge_entry(void)
+{
+	PC_Complete = FALSE;
+	MC_Complete = FALSE;
+	relay_close(RLY_MCPC | RLY_EXT_MCPC);		//close MCPC contactor and external pc relay to read signals
+	precharge_start();
+}
 
-			can_flag_check();
-		}  // End periodic communications
+/*
+ * Precharge signals every tick once the precharge contactor is in, a failed
+ * precharge trips like any other fault
+ */
+static void precharge_during(void)
+{
+	unsigned long t_sample;
+	unsigned char err;
+
+	if((relay.closed & RLY_MCPC) == 0) return;		//contactor still pulling in
+	t_sample = probe_time();
+	precharge_sample();
+	err = precharge_update(SIG1, SIG2, SIG3);
+	if(err != 0x00) bps_trip(err, t_sample);
+}
 
-		  // Check for CAN packet reception
-		if(((P1IN & CAN_INTn) == 0x00) && send_can)
-		{
-		// IRQ flag is set, so run the receive routine to either get the message, or the error
-			can_receive();
-		// Check the status
-		// Modification: case based updating of actual current and velocity added
-		// - messages received at 5 times per second 16/(2*5) = 1.6 sec smoothing
-			if(can.status == CAN_OK)
-			{
-				LED_ERROR_OFF;
-				switch(can.address)
-				{
-				case DC_CAN_BASE + DC_SWITCH:
-					switches_out_dif  = can.data.data_u16[3];
-					switches_dif_save = can.data.data_u16[2];
-					switches_out_new  = can.data.data_u16[1];
-					switches_new      = can.data.data_u16[0];
-					if((switches_new & SW_IGN_ON) == 0x00)
-					{
-						if((switches_out_new & 0xFF00) == 0xFF00)
-						{
-							can_start_precharge = TRUE;
-						}
-					}
-					else
-					{
-						can_car_enable = TRUE;
-					}
-					if((switches_new & SW_IGN_ACC) == 0x00)
-					{
-						if((switches_out_new & 0xFF00) == 0x0F00)
-						{
-							dc_charge_mode = TRUE;
-						}
-					}
-					else
-					{
-						dc_charge_mode = FALSE;
-					}
-					// Add DC Charge mode here
-					break;
-				case AC_CAN_BASE + AC_BP_CHARGE:
-					AC_char3 = can.data.data_u8[7];
-					AC_char2 = can.data.data_u8[6];
-					AC_char1 = can.data.data_u8[5];
-					AC_char0 = can.data.data_u8[4];
-					AC_Serial_No = can.data.data_u32[0];
-					// If ACV1 charge mode, else 0x0000
-					if((AC_char3 == 'A') && (AC_char2 == 'C') && (AC_char1 == 'v') && (AC_char0 == '1'))
-					{
-						ac_charge_mode = TRUE;
-					}
-					else
-					{
-						ac_charge_mode = FALSE;
-					}
+/*
+ * Caps converged on the battery and the motor controller side followed
+ */
+static unsigned char mc_ready(void)
+{
+	return(pchg.state == PCHG_MC_READY);
+}
 
-					break;
-				default:
-					break;
-				}
+/*
+ * PC is complete at this point
+ */
+static void mc_close(void)
+{
+	PC_Complete = TRUE;
+	MC_Complete = TRUE;
+	relay_close(RLY_MC);		  				//close MC contactor
+	relay_open(RLY_MCPC | RLY_EXT_MCPC);		//open MCPC contactor and external PC relay
+
+	// Transmit Precharge CAN Message
+	can.address = BP_CAN_BASE + BP_PCDONE;
+	can.data.data_u8[7] = 'B';
+	can.data.data_u8[6] = 'P';
+	can.data.data_u8[5] = 'v';
+	can.data.data_u8[4] = '1';
+	can.data.data_u32[0] = DEVICE_SERIAL;
+	cancheck_flag=can_transmit();
+	if(cancheck_flag == 1) can_init();
+}
 
-			}
-			else if(can.status == CAN_RTR)
-			{
-				LED_ERROR_OFF;
-				switch(can.address)
-				{
-					case BP_CAN_BASE:
-						can.address = BP_CAN_BASE;
-						can.data.data_u8[7] = 'B';
-						can.data.data_u8[6] = 'P';
-						can.data.data_u8[5] = 'v';
-						can.data.data_u8[4] = '1';
-						can.data.data_u32[0] = DEVICE_SERIAL;
-						can_transmit();
-						break;
-					case BP_CAN_BASE + BP_VMAX:
-						can.data.data_fp[1] = max_voltage;
-						can.data.data_fp[0] = (float) max_v_cell;
-						can_transmit();
-						break;
-					case BP_CAN_BASE + BP_VMIN:
-						can.data.data_fp[1] = min_voltage;
-						can.data.data_fp[0] = (float) min_v_cell;
-						can_transmit();
-						break;
-					case BP_CAN_BASE + BP_TMAX:
-						can.data.data_fp[1] = max_temp;
-						can.data.data_fp[0] = (float) max_temp_idx;
-						can_transmit();
-						break;
-					case BP_CAN_BASE + BP_ISH:
-						can.data.data_fp[1] = current;
-						can.data.data_fp[0] = (float) max_voltage * 0.0015;
-						can_transmit();
-						break;
-					case BP_CAN_BASE + BP_PCDONE:
-						if(bpsMODE == NORMALOP)
-						{
-							can.data.data_u8[7] = 'B';
-							can.data.data_u8[6] = 'P';
-							can.data.data_u8[5] = 'v';
-							can.data.data_u8[4] = '1';
-							can.data.data_u32[0] = DEVICE_SERIAL;
-						}
-						else
-						{
-							can.data.data_u8[7] = 0x00;
-							can.data.data_u8[6] = 0x00;
-							can.data.data_u8[5] = 0x00;
-							can.data.data_u8[4] = 0x00;
-							can.data.data_u32[0] = DEVICE_SERIAL;
-						}
-						can_transmit();
-						break;
-				}
-			}
-			else if(can.status == CAN_ERROR)
-			{
-				LED_ERROR_TOG;
-				can_err_cnt++;
-			}
-		}
+/*
+ * CHARGE: MC and precharge open, battery and array stay closed
+ */
+static void charge_entry(void)
+{
+	relay_open(RLY_DRIVE);
+	bps_strobe_off;
+}
 
-		/////////////////////////////////////////HANDLE RS232//////////////////////////////////////////
+static void charge_exit(void)
+{
+	PC_Complete = FALSE;
+	MC_Complete = FALSE;
+	charge_mode = 0x00;
+}
 
-		if(batt_temp_status)	//cell temperatures
-		{
-			batt_temp_status = 0;
-			BPS2PC_puts("\nBATTERY TEMPERATURES:");
-			BPS2PC_puts("MAX Discharge Temp = 60 Degree C");
-			BPS2PC_puts("MAX Charge Temp = 45 Degree C\n");
+/*
+ * The controller that asked for charge mode has left it (button charge mode stays)
+ */
+static unsigned char charge_ended(void)
+{
+	return(((charge_mode == 0x01) && !dc_charge_mode) || ((charge_mode == 0x02) && !ac_charge_mode));
+}
 
-			for(i = 1; i < 40; i++)
-			{
-				volt = ((float) temperature_adc[i] / 16777216.0); // voltage ratio
-				temp = 126.1575-311.329*volt;  // Linear Est. of Temp 20 - 45
-				temp1 = (int)temp;
-				temp2 = (int)(temp * 10) % 10;
-				temp3 = (int)(temp * 100) %10;
-
-				sprintf(buff,"Temp %d = %d.%d%d Degree C",i,temp1,temp2,temp3);
-				BPS2PC_puts(buff);
-			}
+/*
+ * ERRORMODE: indicators, DR LEDs show the fault code
+ */
+static void error_entry(void)
+{
+	LED_ERROR_ON;
+	LED_NORMALOP_OFF;
+	bps_strobe_on;
+	capture_err = (batt_ERR>>4) & 0x0F;
+	DR_LED_SHOW(capture_err);
 
-			temp = max_temp;
-			temp1 = (int)temp;
-			temp2 = (int)(temp * 10) % 10;
-			temp3 = (int)(temp * 100) %10;
-			sprintf(buff,"Max Temp %d = %d.%d%d Degree C",max_temp_idx,temp1,temp2,temp3);
-			BPS2PC_puts(buff);
+	PC_Complete = FALSE;
+	MC_Complete = FALSE;
 
-		}
+	send_can = FALSE;
+}
+
+/*
+ * NORMALOP / CHARGE heartbeat
+ */
+static void mode_blink(void)
+{
+	static unsigned int last = 0;
+
+	if((unsigned int)(tick_count - last) >= MODE_BLINK_TICKS)
+	{
+		last = tick_count;
+		LED_NORMALOP_TOG;
+	}
+}
 
-		else if(batt_volt_status)										//cell voltages
+/*
+ * Precharge signals, restarts the continuous conversions each time
+ */
+static void precharge_sample(void)
+{
+	//start cont conv for PC signals
+	adc_misc_contconv_start(5);								//battery signal 			(SIGNAL 1)
+	adc_misc_contconv_start(6);								//precharge resistor signal (SIGNAL 2)
+	adc_misc_contconv_start(7);								//motor contactor signal    (SIGNAL 3)
+
+	SIG1 = adc_misc_read_convert(5);
+	SIG2 = adc_misc_read_convert(6);
+	SIG3 = adc_misc_read_convert(7);
+}
+
+/*
+ * Current and temperature task, every LTC_STATUS_COUNT/2 ticks
+ */
+static void task_measure(void)
+{
+	unsigned int i;
+	unsigned long t_temp, t_current;
+	unsigned long t_max, t_min;
+	unsigned char broken;
+
+	//start adc battery temp continuous conversions
+	for(dev = 1; dev < 4; dev++)								//device {1:3}
+	{
+		for(ch = 0; ch < 8; ch++)								//channel {0:7}
 		{
+			adc_bus1_contconv_start(ch,dev);
+			adc_bus2_contconv_start(ch,dev);
+		}
+	}
 
-			batt_volt_status = 0;
-			BPS2PC_puts("\nBATTERY CELL VOLTAGES:");
-			BPS2PC_puts("MAX CELL VOLTAGE 4.176 V");
-			BPS2PC_puts("MIN CELL VOLTAGE 2.640 V\n");
+	//start continuous conversion for shunt measurement
+	adc_misc_contconv_start(4);
+	adc_misc_contconv_start(1);
+	//start continous conversion for misc temperatures
+	adc_misc_contconv_start(2);
+	adc_misc_contconv_start(3);
 
-			for(i = 0; i < 11; i++)
-			{
-				temp = (float) (ltc1_cv[i]-512) / 666.66;								//conversion to volts
-				temp1 = (int)temp;										//integer value
-				temp2 = (int)(temp * 10) % 10;							//tenths place
-				temp3 = (int)(temp * 100) %10;							//hundredths place
+	//no current with every contactor open, the shunt code is the zero offset
+	if(((bpsMODE == SELFCHECK) || (bpsMODE == ERRORMODE)) && (relay.cmd == 0x00) && (relay.moving == 0x00))
+	{
+		shunt_read();
+		temperature_adc[38] = adc_misc_read_convert(3);
+		zero_sample(diff_shunt - diff_ref, temperature_adc[38]);
+	}
 
-				sprintf(buff, "Cell %d = %d.%d%d Volts",i,temp1,temp2,temp3);
-				BPS2PC_puts(buff);
-			}
-			for(i = 0; i < 12; i++)
-			{
-				temp = (float)(ltc2_cv[i]-512) / 666.66;
-				temp1 = (int)temp;
-				temp2 = (int)(temp * 10) % 10;
-				temp3 = (int)(temp * 100) %10;
+	if(bpsMODE !=SELFCHECK)
+	{
+	///////////////BATTERY TEMPS
+	t_temp = probe_time();
+	//read adc bus1 device 1 temperatures
+	for(i = 1; i < 8; i++)
+	{
+		temperature_adc[8-i] = adc_bus1_read_convert(i,1);		//store temp {1:7}
+	}
+	//read adc bus1 device 2 temperatures
+	for(i = 1; i < 8; i++)
+	{
+		temperature_adc[15-i] = adc_bus1_read_convert(i,2);		//store temp {8:14}
+	}
+	//read adc bus1 device 3 temperatures
+	for(i = 1; i < 8; i++)
+	{
+		temperature_adc[22-i] = adc_bus1_read_convert(i,3);		//store temp {15:21}
+	}
+	//read adc bus2 device 1 temperatures
+	for(i = 1; i < 8; i++)
+	{
+		temperature_adc[29-i] = adc_bus2_read_convert(i,1);		//store temp {22:28}
+	}
+	//read adc bus2 device 2 temperatures
+	for(i = 1; i < 8; i++)
+	{
+		temperature_adc[36-i] = adc_bus2_read_convert(i,2);		//store temp {29:35}
+	}
 
-				sprintf(buff, "Cell %d = %d.%d%d Volts",i+11,temp1,temp2,temp3);
-				BPS2PC_puts(buff);
-			}
-			for(i = 0; i < 12; i++)
-			{
-				temp = (float) (ltc3_cv[i]-512) / 666.66;
-				temp1 = (int)temp;
-				temp2 = (int)(temp * 10) % 10;
-				temp3 = (int)(temp * 100) %10;
+	///////////ADDITIONAL TEMPS
+	temperature_adc[36] = adc_bus2_read_convert(7,3);			//store inlet temp  {36}
+	temperature_adc[37] = adc_bus2_read_convert(6,3);			//store outlet temp {37}
 
-				sprintf(buff, "Cell %d = %d.%d%d Volts",i+23,temp1,temp2,temp3);
-				BPS2PC_puts(buff);
-			}
+	temperature_adc[38] = adc_misc_read_convert(3);				//store misc temp 	{38}
+	temperature_adc[39] = adc_misc_read_convert(2);				//store misc temp 	{39}
 
-			temp = (float) (bat_voltage) / 666.66;
-			temp1 = (int)temp;
-			temp2 = (int)(temp * 10) % 10;
-			temp3 = (int)(temp * 100) %10;
-			sprintf(buff, "Battery = %d.%d%d Volts",temp1,temp2,temp3);
-			BPS2PC_puts(buff);
+	broken = TRIP_OK;
+	for(i = 3; i < 40; i++)								//check temperature cells {1:35}
+	{
+		if(temperature_adc[i] >= MIN_TEMP_NOSENSOR)	//temp max is 60 degree C discharging
+		{
+			broken = TRIP_MARGINAL;
 		}
+	}
+	trip_sample(TRIP_TEMP_SENSOR, broken, 0x60, t_temp); 	// Broken Temp Sensor
+	trise_update(t_temp);									// dT/dt per sensor
+
+	/////////CHECK LIMITS
+
+	//get current direction across batt shunt
+	zero_track(temperature_adc[38]);				//offset at the misc ADC temperature
+	current_dvolt = shunt_read();
+	t_current = probe_time();
+
+	i2t_sample(current_dvolt, t_current);			//I2t overload, below the instantaneous limits
+	soc_sample(current_dvolt, t_current);			//coulomb count
+
+	current = (float)(current_dvolt) * CURRENT_I_SCALE;
+	current /= CURRENT_FULL_SCALE;			// in mA
+	ix_bps_sample((long) current, tick_count);
+	pack_temp_update();
+	limits_update((long) current);
+	stream_sample(bpsMODE, batt_ERR, (batt_KILL ? STREAM_FLAG_KILL : 0) | (ltc_error ? STREAM_FLAG_LTC : 0) |
+		((packv.status & PACKV_STALE) ? STREAM_FLAG_PACKV : 0));
+
+	//hottest cell sensor, lowest code {1:35}
+	t_min = temperature_adc[1];
+	for(i = 2; i < 36; i++)
+	{
+		if(temperature_adc[i] < t_min) t_min = temperature_adc[i];
+	}
 
-		else if(batt_current_status)								//battery current
+	//check temperature and current limits if discharging
+	if(current >= 0)								//adc > ref  (DISCHARGING)
+	{
+		trip_sample(TRIP_OC_CHARGE, TRIP_OK, 0x40, t_current);
+		if(current >= MAX_CURRENT_DISCHARGE)					//over current check
 		{
-			batt_current_status = 0;
-
-			BPS2PC_puts("\nBATTERY CURRENT:");
-			BPS2PC_puts("MAX CURRENT DISCHARGE 80200 mA");
-			BPS2PC_puts("MAX CURRENT CHARGE   -19500 mA\n");
-
-			temp = current;
-			temp1 = (int)temp;
-			temp2 = abs((int)(temp * 10) % 10);
-			temp3 = abs((int)(temp * 100) %10);
+			trip_sample(TRIP_OC_DISCHARGE, trip_scale((unsigned long)(current - MAX_CURRENT_DISCHARGE) + 1,
+				(unsigned long)(MAX_CURRENT_DISCHARGE / TRIP_OC_SEVERE_DIV)), 0x30, t_current); 	// Max Current Discharge
+		}
+		else
+		{
+			trip_sample(TRIP_OC_DISCHARGE, TRIP_OK, 0x30, t_current);
+		}
+		t_max = MAX_TEMP_DISCHARGE;						//temp max is 60 degree C discharging
+	}
 
-			sprintf(buff, "Battery Current = %d.%d%d mA",temp1,temp2,temp3);
-			BPS2PC_puts(buff);
+	//check temperature and current limitsbattery current if charging
+	else											//adc < ref (CHARGING)
+	{
+		trip_sample(TRIP_OC_DISCHARGE, TRIP_OK, 0x30, t_current);
+		if(current <= MAX_CURRENT_CHARGE)						//over current check
+		{
+			trip_sample(TRIP_OC_CHARGE, trip_scale((unsigned long)(MAX_CURRENT_CHARGE - current) + 1,
+				(unsigned long)(-MAX_CURRENT_CHARGE / TRIP_OC_SEVERE_DIV)), 0x40, t_current);	// Max Current Charge
 		}
-		else if(batt_state_status)								//battery current
+		else
 		{
-			batt_state_status = 0;
+			trip_sample(TRIP_OC_CHARGE, TRIP_OK, 0x40, t_current);
+		}
+		t_max = MAX_TEMP_CHARGE;						//temp max is 45 degree C charging
+	}
 
-			BPS2PC_puts("\nBATTERY STATE:");
+	//over temperature, the thermistor code falls as the cell heats
+	if(t_min <= t_max)
+	{
+		trip_sample(TRIP_OVERTEMP, trip_scale(t_max - t_min + 1, TRIP_OT_SEVERE), 0x50, t_temp);	// MAX temperature
+	}
+	else
+	{
+		trip_sample(TRIP_OVERTEMP, TRIP_OK, 0x50, t_temp);
+	}
+	}
+}
 
-			sprintf(buff, "Battery State = %d",bpsMODE+1);
-			BPS2PC_puts(buff);
-		}
+/*
+ * Shunt minus reference ADC code less the zero offset, read several times to avoid invalid data
+ *	- diff_shunt and diff_ref keep the uncorrected codes
+ */
+static long shunt_read(void)
+{
+	unsigned int i;
 
-		///////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	for(i = 5; i > 0; i--)
+	{
+		diff_ref = adc_misc_read_convert(1);
+		diff_shunt = adc_misc_read_convert(4);
+	}
+	return(diff_shunt - diff_ref - zero.offset);
+}
 
-		// BUTTON1 Press Received   
-		if(((P1IN & BUTTON1) != BUTTON1) || ((int_op1_flag & 0x08) == 0x08))
-		{
-			int_op1_flag &= 0x08;
-		    
-			//open all relays
-			relay_mcpc_open;
-			ext_relay_mcpc_open;
-			relay_mc_open;
+/*
+ * Publishes the current limits, and one cell resistance, at the motor controller frame rate
+ */
+static void task_limits(void)
+{
+	if(!send_can) return;
 
-			bps_strobe_off;
+	can.address = BP_CAN_BASE + BP_LIMITS;
+	can.data.data_fp[1] = (float) pack.dcl * 0.001;
+	can.data.data_fp[0] = (float) pack.ccl * 0.001;
+	can_transmit();
 
-		   	bpsMODE = CHARGE;
-		   	charge_mode |= 0x10;
-		    mode_count = 0;
-		    mode_dwell_count = 0;
-			P6OUT &= ~(LED5);		//DR LED 0x8
-			P6OUT |=  (LED4|LED3|LED2);		//
+	rcell_frame();
+	if(trise.status & TRISE_WARN) trise_frame();		//early warning at the limits rate
+	if(packv.status & (PACKV_STALE | PACKV_MISMATCH)) packv_frame();
+}
+
+/*
+ * Sends the next cell resistance estimate on BP_RCELL (mOhm, cell number)
+ */
+static void rcell_frame(void)
+{
+	static unsigned char cell = 0;
+
+	can.address = BP_CAN_BASE + BP_RCELL;
+	can.data.data_fp[1] = (float) rcell.r_uohm[cell] * 0.001;
+	can.data.data_fp[0] = (float) cell;
+	can_transmit();
 
+	cell++;
+	if(cell >= RCELL_CELLS) cell = 0;
+}
+
+/*
+ * Sends the fastest rising temperature sensor on BP_TRISE
+ */
+static void trise_frame(void)
+{
+	can.address = BP_CAN_BASE + BP_TRISE;
+	can.data.data_fp[1] = (float) trise.max_rate * 0.01;
+	can.data.data_u8[3] = trise.max_idx;
+	can.data.data_u8[2] = trise.status;
+	can.data.data_u16[0] = trise.warn_cnt;
+	can_transmit();
+}
+
+/*
+ * Sends the pack voltage cross check on BP_PACKV, PACKV_STALE when SIG1 has not been usable
+ */
+static void packv_frame(void)
+{
+	can.address = BP_CAN_BASE + BP_PACKV;
+	can.data.data_fp[1] = (float) packv.diff_mv * 0.001;
+	can.data.data_u16[1] = packv.status;
+	can.data.data_u16[0] = packv.skip_run;
+	can_transmit();
+}
+
+/*
+ * Periodic CAN telemetry, every CAN_COMMS_COUNT ticks
+ */
+static void task_comms(void)
+{
+	unsigned int i;
+
+	soc_save();								//info flash record, when the SOC has moved
+	if(!send_can) return;
+
+// Max Cell Voltage and total battery voltage
+	max_v_cell = 0;
+	ltc_max = 0x0000;
+	bat_voltage = 0x00000000;
+	for(i=0;i<=10;i++)
+	{
+		if((ltc1_cv[i])>ltc_max)
+		{
+			ltc_max=ltc1_cv[i];
+			max_v_cell = i;
+		}
+		bat_voltage += (long) (ltc1_cv[i]-512);
+	}
+	for(i=0;i<=11;i++)
+	{
+		if((ltc2_cv[i])>ltc_max)
+		{
+			ltc_max=ltc2_cv[i];
+			max_v_cell = i+11;
+		}
+		bat_voltage += (long) (ltc2_cv[i]-512);
+	}
+	for(i=0;i<=11;i++)
+	{
+		if((ltc3_cv[i])>ltc_max)
+		{
+			ltc_max=ltc3_cv[i];
+			max_v_cell = i+23;
 		}
+		bat_voltage += (long) (ltc3_cv[i]-512);
+	}
 
-		// BUTTON2 Press Received   
-		if(((P1IN & BUTTON2) != BUTTON2) || ((int_op1_flag & 0x04) == 0x04))
+	max_voltage = ((float) (ltc_max-512)) * 0.0015;
+
+// Min Cell Voltage
+	min_v_cell = 0;
+	ltc_min = 0x0FFF;
+	for(i=0;i<=10;i++)
+	{
+		if((ltc1_cv[i])<ltc_min)
 		{
-			int_op1_flag &= 0x04;
+			ltc_min=ltc1_cv[i];
+			min_v_cell = i;
+		}
+	}
+	for(i=0;i<=11;i++)
+	{
+		if((ltc2_cv[i])<ltc_min)
+		{
+			ltc_min=ltc2_cv[i];
+			min_v_cell = i+11;
+		}
+	}
+	for(i=0;i<=11;i++)
+	{
+		if((ltc3_cv[i])<ltc_min)
+		{
+			ltc_min=ltc3_cv[i];
+			min_v_cell = i+23;
+		}
+	}
 
-		    //open all relays
-			relay_mcpc_open;
-			ext_relay_mcpc_open;
-			relay_mc_open;
-			delay();
-			relay_batt_open;
-			delay();
-			relay_array_open;
+	min_voltage = ((float) (ltc_min-512)) * 0.0015;
 
-			bps_strobe_off;
+// Max Cell Temperature Already Computed
+	max_temp_val = 0x00FFFFFF;
+	max_temp_idx = 0x0000;
+	for(i = 39; i > 0; i--)
+	{
+		if(temperature_adc[i]<max_temp_val)
+		{
+			max_temp_val = temperature_adc[i];
+			max_temp_idx = i;
+		}
+	}
 
-		    bpsMODE = INITIALIZE;
-			P6OUT |= (LED2|LED3|LED4|LED5);
-		    DR_LED0_ON;
-		    mode_count = 0;
-		    mode_dwell_count = 0;
+	temp = ((float) max_temp_val / 16777216.0); // voltage ratio
+	max_temp = 126.1575-311.329*temp;  // Linear Est. of Temp 20 - 45
+
+// Transmit CAN message
+// Transmit Max Cell Voltage
+	can.address = BP_CAN_BASE + BP_VMAX;
+	can.data.data_fp[1] = max_voltage;
+	can.data.data_fp[0] = (float) max_v_cell;
+	can_transmit();
+
+// Transmit Min Cell Voltage
+	can.address = BP_CAN_BASE + BP_VMIN;
+	can.data.data_fp[1] = min_voltage;
+	can.data.data_fp[0] = (float) min_v_cell;
+	can_transmit();
+
+// Transmit Max Cell Temperature
+	can.address = BP_CAN_BASE + BP_TMAX;
+	can.data.data_fp[1] = max_temp;
+	can.data.data_fp[0] = (float) max_temp_idx;
+	can_transmit();
+
+// Transmit Shunt Cutrrent
+	can.address = BP_CAN_BASE + BP_ISH;
+	can.data.data_fp[1] = current;
+	can.data.data_fp[0] = (float) max_voltage * 0.0015;
+	can_transmit();
+
+// Transmit our ID frame at a slower rate (every 10 events = 1/second)
+	comms_event_count++;
+	if(comms_event_count >=10)
+	{
+		comms_event_count = 0;
+		can.address = BP_CAN_BASE;
+		can.data.data_u8[7] = 'B';
+		can.data.data_u8[6] = 'P';
+		can.data.data_u8[5] = 'v';
+		can.data.data_u8[4] = '1';
+		can.data.data_u32[0] = DEVICE_SERIAL;
+		cancheck_flag = can_transmit();
+		if(cancheck_flag == 1) can_init();
+	}
 
+	can_flag_check();
+
+// Transmit CAN error counters
+	can.address = BP_CAN_BASE + BP_CANERR;
+	can.data.data_u8[7] = can_err.state;
+	can.data.data_u8[6] = can_err.eflg;
+	can.data.data_u8[5] = can_err.tec;
+	can.data.data_u8[4] = can_err.rec;
+	can.data.data_u16[1] = can_err.busoff_cnt;
+	can.data.data_u16[0] = can_err.err_cnt;
+	can_transmit();
+
+// Transmit current cross check
+	can.address = BP_CAN_BASE + BP_IXCHK;
+	can.data.data_fp[1] = (float) ix.filt;
+	can.data.data_u16[1] = ix.status;
+	can.data.data_u16[0] = ix.drift_cnt;
+	can_transmit();
+
+// Transmit state of charge
+	can.address = BP_CAN_BASE + BP_SOC;
+	can.data.data_fp[1] = (float) soc_permille() * 0.1;
+	can.data.data_fp[0] = (float) soc.q / (float) SOC_Q_PER_MAH * 0.001;
+	can_transmit();
+
+// Transmit temperature rate of rise
+	trise_frame();
+
+// Transmit pack voltage cross check
+	packv_frame();
+}
 
-		}
+/*
+ * CAN receive task, every tick and on CAN_INTn
+ *	- Bus-off recovery, then drains the MCP2515 and handles the queued frames
+ */
+static void task_can(void)
+{
+	// Recover the CAN controller from bus-off once its back-off has expired
+	if(can_error_service())
+	{
+		LED_ERROR_TOG;
+	}
 
-		//handle batt_KILL error
+	  // Check for CAN packet reception (CAN_INTn edge, or the line is still held low)
+	if((((int_op2_flag & 0x01) == 0x01) || ((P2IN & CAN_INTn) == 0x00)) && send_can)
+	{
+		int_op2_flag &= ~0x01;
+	// IRQ flag is set, so move the messages (or errors) into the receive queue
+		can_rx_drain();
+	}
+	while(can_rx_pop())
+	{
+	// Check the status
+	// Modification: case based updating of actual current and velocity added
+	// - messages received at 5 times per second 16/(2*5) = 1.6 sec smoothing
+		if(can.status == CAN_OK)
+		{
+			LED_ERROR_OFF;
+			switch(can.address)
+			{
+			case DC_CAN_BASE + DC_SWITCH:
+				switches_out_dif  = can.data.data_u16[3];
+				switches_dif_save = can.data.data_u16[2];
+				switches_out_new  = can.data.data_u16[1];
+				switches_new      = can.data.data_u16[0];
+				if((switches_new & SW_IGN_ON) == 0x00)
+				{
+					if((switches_out_new & 0xFF00) == 0xFF00)
+					{
+						can_start_precharge = TRUE;
+					}
+				}
+				else
+				{
+					can_car_enable = TRUE;
+				}
+				if((switches_new & SW_IGN_ACC) == 0x00)
+				{
+					if((switches_out_new & 0xFF00) == 0x0F00)
+					{
+						dc_charge_mode = TRUE;
+					}
+				}
+				else
+				{
+					dc_charge_mode = FALSE;
+				}
+				// Add DC Charge mode here
+				break;
+			case MC_CAN_BASE1 + MC_BUS:
+				ix_mc_frame(can.data.data_fp[1], can_rx_tick);
+				break;
+			case AC_CAN_BASE + AC_ISH:
+				ix_ac_frame(can.data.data_fp[1], can_rx_tick);
+				break;
+			case AC_CAN_BASE + AC_BP_CHARGE:
+				AC_char3 = can.data.data_u8[7];
+				AC_char2 = can.data.data_u8[6];
+				AC_char1 = can.data.data_u8[5];
+				AC_char0 = can.data.data_u8[4];
+				AC_Serial_No = can.data.data_u32[0];
+				// If ACV1 charge mode, else 0x0000
+				if((AC_char3 == 'A') && (AC_char2 == 'C') && (AC_char1 == 'v') && (AC_char0 == '1'))
+				{
+					ac_charge_mode = TRUE;
+				}
+				else
+				{
+					ac_charge_mode = FALSE;
+				}
 
-		if(batt_KILL)
+				break;
+			default:
+				break;
+			}
+
+		}
+		else if(can.status == CAN_RTR)
 		{
-			//open all relays
-			relay_mcpc_open;
-			ext_relay_mcpc_open;
-			relay_mc_open;
-			delay();
-			relay_batt_open;
-			delay();
-			relay_array_open;
-
-			if(bpsMODE != ERRORMODE)
+			LED_ERROR_OFF;
+			switch(can.address)
 			{
-				// Set Indicators
-				LED_ERROR_ON;
-				LED_NORMALOP_OFF;
-				bps_strobe_on;
-				capture_err = (batt_ERR>>4) & 0x0F;
-				P6OUT |= 0x0F;
-				P6OUT &= ~(capture_err);
-
-				PC_Complete = FALSE;
-				MC_Complete = FALSE;
-
-				send_can = FALSE;
+				case BP_CAN_BASE:
+					can.address = BP_CAN_BASE;
+					can.data.data_u8[7] = 'B';
+					can.data.data_u8[6] = 'P';
+					can.data.data_u8[5] = 'v';
+					can.data.data_u8[4] = '1';
+					can.data.data_u32[0] = DEVICE_SERIAL;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_VMAX:
+					can.data.data_fp[1] = max_voltage;
+					can.data.data_fp[0] = (float) max_v_cell;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_VMIN:
+					can.data.data_fp[1] = min_voltage;
+					can.data.data_fp[0] = (float) min_v_cell;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_TMAX:
+					can.data.data_fp[1] = max_temp;
+					can.data.data_fp[0] = (float) max_temp_idx;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_ISH:
+					can.data.data_fp[1] = current;
+					can.data.data_fp[0] = (float) max_voltage * 0.0015;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_CANERR:
+					can.data.data_u8[7] = can_err.state;
+					can.data.data_u8[6] = can_err.eflg;
+					can.data.data_u8[5] = can_err.tec;
+					can.data.data_u8[4] = can_err.rec;
+					can.data.data_u16[1] = can_err.busoff_cnt;
+					can.data.data_u16[0] = can_err.err_cnt;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_LIMITS:
+					can.data.data_fp[1] = (float) pack.dcl * 0.001;
+					can.data.data_fp[0] = (float) pack.ccl * 0.001;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_IXCHK:
+					can.data.data_fp[1] = (float) ix.filt;
+					can.data.data_u16[1] = ix.status;
+					can.data.data_u16[0] = ix.drift_cnt;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_PROBE:
+					probe_frame();
+					break;
+				case BP_CAN_BASE + BP_RCELL:
+					rcell_frame();
+					break;
+				case BP_CAN_BASE + BP_TRISE:
+					trise_frame();
+					break;
+				case BP_CAN_BASE + BP_PACKV:
+					packv_frame();
+					break;
+				case BP_CAN_BASE + BP_SOC:
+					can.data.data_fp[1] = (float) soc_permille() * 0.1;
+					can.data.data_fp[0] = (float) soc.q / (float) SOC_Q_PER_MAH * 0.001;
+					can_transmit();
+					break;
+				case BP_CAN_BASE + BP_PCDONE:
+					if(bpsMODE == NORMALOP)
+					{
+						can.data.data_u8[7] = 'B';
+						can.data.data_u8[6] = 'P';
+						can.data.data_u8[5] = 'v';
+						can.data.data_u8[4] = '1';
+						can.data.data_u32[0] = DEVICE_SERIAL;
+					}
+					else
+					{
+						can.data.data_u8[7] = 0x00;
+						can.data.data_u8[6] = 0x00;
+						can.data.data_u8[5] = 0x00;
+						can.data.data_u8[4] = 0x00;
+						can.data.data_u32[0] = DEVICE_SERIAL;
+					}
+					can_transmit();
+					break;
 			}
-			batt_KILL = FALSE;
+		}
+		else if(can.status == CAN_ERROR)
+		{
+			LED_ERROR_TOG;				// counted in can_err by can_receive()
+		}
+	}
+}
+
+/*
+ * Execution time probes on CAN, one probe per frame in turn
+ */
+static void task_probe(void)
+{
+	if(!send_can) return;
+
+	probe_frame();
+}
+
+/*
+ * Sends the next probe on BP_PROBE: id, top histogram bin, avg, max and min (us, saturated)
+ */
+static void probe_frame(void)
+{
+	static unsigned char id = 0;
+	unsigned long avg;
+	unsigned char bin;
+
+	avg = 0;
+	if(probe[id].count != 0) avg = (unsigned long) (probe[id].sum / probe[id].count);
+	for(bin = PROBE_BINS - 1; (bin > 0) && (probe[id].hist[bin] == 0); bin--);
+
+	can.address = BP_CAN_BASE + BP_PROBE;
+	can.data.data_u8[7] = id;
+	can.data.data_u8[6] = bin;
+	can.data.data_u16[2] = (avg > 0xFFFF) ? 0xFFFF : (unsigned int) avg;
+	can.data.data_u16[1] = (probe[id].max > 0xFFFF) ? 0xFFFF : (unsigned int) probe[id].max;
+	can.data.data_u16[0] = (probe[id].count == 0) ? 0 : ((probe[id].min > 0xFFFF) ? 0xFFFF : (unsigned int) probe[id].min);
+	can_transmit();
+
+	id++;
+	if(id >= PROBE_COUNT) id = 0;
+}
 
-			bpsMODE = ERRORMODE;
-		    mode_count = 0;
-		    mode_dwell_count = 0;
+/*
+ * RS232 task, runs the command line and the long outputs it asks for
+ */
+static void task_pc(void)
+{
+	unsigned int i;
 
+	command_process();		//run any received command line
+
+	if(batt_temp_status)	//cell temperatures
+	{
+		batt_temp_status = 0;
+		BPS2PC_puts("\nBATTERY TEMPERATURES:");
+		BPS2PC_puts("MAX Discharge Temp = 60 Degree C");
+		BPS2PC_puts("MAX Charge Temp = 45 Degree C\n");
+
+		for(i = 1; i < 40; i++)
+		{
+			BPS2PC_put_str("Temp ");
+			BPS2PC_put_dec(i);
+			BPS2PC_put_str(" = ");
+			BPS2PC_put_fixed(ADC_TO_CENTI_C(temperature_adc[i]), 2);	// Linear Est. of Temp 20 - 45
+			BPS2PC_puts(" Degree C");
 		}
-		else
+
+		BPS2PC_put_str("Max Temp ");
+		BPS2PC_put_dec(max_temp_idx);
+		BPS2PC_put_str(" = ");
+		BPS2PC_put_fixed(ADC_TO_CENTI_C(max_temp_val), 2);
+		BPS2PC_puts(" Degree C");
+	}
+
+	else if(batt_volt_status)										//cell voltages
+	{
+
+		batt_volt_status = 0;
+		BPS2PC_puts("\nBATTERY CELL VOLTAGES:");
+		BPS2PC_puts("MAX CELL VOLTAGE 4.176 V");
+		BPS2PC_puts("MIN CELL VOLTAGE 2.640 V\n");
+
+		for(i = 0; i < 35; i++)
 		{
-			LED_ERROR_OFF;
+			BPS2PC_put_str("Cell ");
+			BPS2PC_put_dec(i);
+			BPS2PC_put_str(" = ");
+			if(i < 11) BPS2PC_put_fixed(LTC_CODE_TO_MV(ltc1_cv[i]), 3);			//mV to volts
+			else if(i < 23) BPS2PC_put_fixed(LTC_CODE_TO_MV(ltc2_cv[i-11]), 3);
+			else BPS2PC_put_fixed(LTC_CODE_TO_MV(ltc3_cv[i-23]), 3);
+			BPS2PC_puts(" Volts");
 		}
-		WDTCTL = WDT_ARST_1000; // Stop watchdog timer to prevent time out reset
 
-	} //end while(TRUE)
+		BPS2PC_put_str("Battery = ");
+		BPS2PC_put_fixed((bat_voltage * 3) / 2, 3);					//code sum is 1.5 mV per count
+		BPS2PC_puts(" Volts");
+	}
 
+	else if(batt_current_status)								//battery current
+	{
+		batt_current_status = 0;
+
+		BPS2PC_puts("\nBATTERY CURRENT:");
+		BPS2PC_puts("MAX CURRENT DISCHARGE 80200 mA");
+		BPS2PC_puts("MAX CURRENT CHARGE   -19500 mA\n");
+
+		BPS2PC_put_str("Battery Current = ");
+		BPS2PC_put_dec((long) current);
+		BPS2PC_puts(" mA");
+	}
+	else if(batt_state_status)								//battery current
+	{
+		batt_state_status = 0;
+
+		BPS2PC_puts("\nBATTERY STATE:");
+
+		BPS2PC_put_str("Battery State = ");
+		BPS2PC_put_dec(bpsMODE+1);
+		BPS2PC_puts("");
+		BPS2PC_put_str("TX drop ");
+		BPS2PC_put_udec(pc_tx_drop);
+		BPS2PC_put_str(" peak ");
+		BPS2PC_put_udec(pc_tx_peak);
+		BPS2PC_puts("");
+		BPS2PC_put_str("RX drop ");
+		BPS2PC_put_udec(pc_rx_drop);
+		BPS2PC_puts("");
+		BPS2PC_put_str("Stream drop ");
+		BPS2PC_put_udec(stream_drop);
+		BPS2PC_puts("");
+	}
 }
-/*================================ ** END MAIN** =========================================*/
-////////////////////////////////////////////////////////////////////////////////////////////
 
 /*
 * Initialise Timer B
@@ -1229,8 +1503,8 @@ void timerB_init( void )
 
 /*
 * Timer B CCR0 Interrupt Service Routine
-*	- Interrupts on Timer B CCR0 match at 10Hz
-*	- Sets Time_Flag variable
+*	- Interrupts on Timer B CCR0 match at TICK_RATE
+*	- Releases the periodic tasks
 */
 /*
 * GNU interropt symantics
@@ -1239,70 +1513,51 @@ void timerB_init( void )
 #pragma vector = TIMERB0_VECTOR
 __interrupt void timer_b0(void)
 {
-	static unsigned int status_count = LTC_STATUS_COUNT;
-	static unsigned int temp_count = LTC_STATUS_COUNT/2;
-	static unsigned int cancomm_count = CAN_COMMS_COUNT;
-
-	status_count--;
-	temp_count--;
-    if( status_count == 0 )
-    {
-    	status_count = LTC_STATUS_COUNT;
-    	status_flag = TRUE;
-    }
-    if(temp_count == 0)
-    {
-    	temp_count = LTC_STATUS_COUNT/2;
-    	temp_flag = TRUE;
-    }
-    if(send_can) cancomm_count--;
-    if( cancomm_count == 0 )
-    {
-        cancomm_count = CAN_COMMS_COUNT;
-        cancomm_flag = TRUE;
-    }
+	probe_begin(PROBE_ISR_TICK);
+	tick_count++;
+	relay_tick();								//contactor sequence and readback
+	sched_tick();								//release periodic tasks
+	probe_end(PROBE_ISR_TICK);
+	__bic_SR_register_on_exit(LPM0_bits);		//wake the main loop
+}
+
+/*
+* Timer A0 overflow Interrupt Service Routine
+*	- Extends the probe timestamp to 32 bits
+*/
+#pragma vector = TIMER0_A1_VECTOR
+__interrupt void timer_a0(void)
+{
+  switch(__even_in_range(TA0IV,14))
+  {
+  case 14:                                  // Vector 14 - TA0IFG, overflow
+	probe_overflow_int();
+    break;
+  default:
+    break;
+  }
 }
 
 //RS232 Interrupt
 #pragma vector = USCI_A3_VECTOR
 __interrupt void USCI_A3_ISR(void)
 {
-	UCA3IV = 0x00;
-
-	command[rs232_count] = BPS2PC_getchar();		//get character
-	BPS2PC_putchar(command[rs232_count]);			//put character
-
-	if(command[rs232_count] == 0x0D)				//if return
-	{
-		rs232_count = 0x00;							//reset counter
-		if(strcmp(batt_temp,command) == 0) batt_temp_status = 1;
-		else if(strcmp(batt_volt,command) == 0) batt_volt_status = 1;
-		else if(strcmp(batt_current, command) == 0) batt_current_status = 1;
-		else if(strcmp(batt_state, command) == 0) batt_state_status = 1;
-		else
-		{
-			batt_temp_status = 0;
-			batt_volt_status = 0;
-			batt_current_status = 0;
-			batt_state_status = 0;
-		}
-
-		for(i = 0; i < 31; i++)
-		{
-			command[i] = 0;							//reset command
-		}
-		BPS2PC_putchar(0x0A);						//new line
-		BPS2PC_putchar(0x0D);						//return
-	}
-	else if(command[rs232_count] != 0x7F)			//if not backspace
-	{
-		rs232_count++;
-	}
-	else
-	{
-		rs232_count--;
-	}
-
+  probe_begin(PROBE_ISR_RS232);
+  switch(__even_in_range(UCA3IV,4))
+  {
+  case 0:break;                             // Vector 0 - no interrupt
+  case 2:                                   // Vector 2 - RXIFG
+	BPS2PC_get_int();						//queue received byte
+	sched_release(TASK_PC);
+	__bic_SR_register_on_exit(LPM0_bits);
+    break;
+  case 4:                                   // Vector 4 - TXIFG
+	BPS2PC_put_int();						//send next queued byte
+    break;
+  default:
+    break;
+  }
+  probe_end(PROBE_ISR_RS232);
 }
 
 /*
@@ -1311,6 +1566,7 @@ __interrupt void USCI_A3_ISR(void)
 	#pragma vector=PORT1_VECTOR
 __interrupt void P1_ISR(void)
 {
+  probe_begin(PROBE_ISR_PORT1);
   switch(__even_in_range(P1IV,16))
   {
   case 0:break;                             // Vector 0 - no interrupt
@@ -1320,9 +1576,11 @@ __interrupt void P1_ISR(void)
     break;
   case 6:                                   // Vector 1.2 - BUTTON1
     int_op1_flag |= 0x08;
+    __bic_SR_register_on_exit(LPM0_bits);
     break;
   case 8:                                   // Vector 1.3 - BUTTON2
     int_op1_flag |= 0x04;
+    __bic_SR_register_on_exit(LPM0_bits);
    break;
   case 10:                                  // Vector 1.4 -
     break;
@@ -1337,6 +1595,7 @@ __interrupt void P1_ISR(void)
   default:
     break;
   }
+  probe_end(PROBE_ISR_PORT1);
 }
 
 /*
@@ -1345,11 +1604,14 @@ __interrupt void P1_ISR(void)
 	#pragma vector=PORT2_VECTOR
 __interrupt void P2_ISR(void)
 {
+  probe_begin(PROBE_ISR_PORT2);
   switch(__even_in_range(P2IV,16))
   {
   case 0:break;                             // Vector 0 - no interrupt
   case 2:                                   // Vector 2.0 - CAN_INTn
 	  int_op2_flag |= 0x01;
+	  sched_release(TASK_CAN);
+	  __bic_SR_register_on_exit(LPM0_bits);
     break;
   case 4:                                   // Vector 2.1 - ADC1_RDYn
 	  int_op2_flag |= 0x02;
@@ -1375,6 +1637,7 @@ __interrupt void P2_ISR(void)
   default:
     break;
   }
+  probe_end(PROBE_ISR_PORT2);
 }
 
 
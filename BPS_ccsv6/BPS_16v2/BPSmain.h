@@ -43,12 +43,34 @@ static inline void delay(void)
 #define LTC_STATUS_COUNT		13			// Number of ticks per event: ~0.133 sec
 #define TEXT_COMMS_COUNT	 100*15			// Number of ticks per event: 7 sec
 #define CAN_COMMS_COUNT		100*2			// Number of ticks per event: 4 sec
+#define LIMITS_COMMS_COUNT		20			// Number of ticks per event: 0.2 sec
+#define PC_TASK_COUNT			10			// Number of ticks per event: 0.1 sec
+#define CAN_RX_DEADLINE			5			// Ticks from CAN_INTn to the frames read out
+#define PROBE_CAN_COUNT			20			// Number of ticks per event: 0.2 sec
+
+// Mode sequencing (mode.c), dwell times in ms
+#define MODE_READY_MS			1000		// BPSREADY, ARRAYREADY: contactor closed and settled
+#define MODE_CANCHECK_MS		1000		// CANCHECK before charge / precharge requests are taken
+#define MODE_BLINK_TICKS		TICK_RATE	// NORMALOP / CHARGE heartbeat: 1 sec
 
 // C == 3.35*12 = 40.2. Discharge 2C, Charge 1.625*12 = 19.5
 // Hopefulley - 60 AMps (-60 mV to +31.5 mV at the shunt)
 #define KI_DISCHARGE  	+80000.0
 #define KI_CHARGE  		-19500.0
 
+// Thermistor ADC limits (raw code falls as temperature rises)
+#define MAX_TEMP_DISCHARGE 		0x003476b9 		//59 Degree C
+#define MAX_TEMP_CHARGE   		0x0042bbff		//45 Degree C
+#define MIN_TEMP_NOSENSOR  		0x006244b5		//Therm not connected
+// Computed from data sheet +/-1%
+//0x337a7d is 60 deg (140 F)
+//0x3476b9 is 59 deg (131 F)
+//0x388c06 is 55 deg (131 F)
+//0x42bbff is 45 deg (113 F)
+//0x54b605 is 25 deg ( 77 F)
+//0x6244b5 is  0 deg ( 32 F)
+//0x6942ef is Therm not connected
+
 // ADC scaling constants */
 #define CURRENT_FULL_SCALE    16777216.0
 // Diff Amp gain is 18.675 -- 18.675 * 53.5 = 1000
@@ -229,6 +251,7 @@ static inline void delay(void)
  * 	 LED_INIT_OFF    : Turn off initialization light
  *   DR_LED1_ON       : Turn on pre-charge light
  *   DR_LED1_OFF      : Turn off pre-charge light
+ *   DR_LED_SHOW(c)   : Show the 4 bit code c on DR LED0..3 (mode + 1, or the fault code)
  *
 */
 
@@ -246,6 +269,8 @@ static inline void delay(void)
 #define DR_LED2_OFF    	    P6OUT |=  LED4;
 #define DR_LED3_ON	  		P6OUT &= ~LED5;	//active low
 #define DR_LED3_OFF    	    P6OUT |=  LED5;
+#define DR_LED_MASK			(LED2|LED3|LED4|LED5)
+#define DR_LED_SHOW(c)		{ P6OUT |= DR_LED_MASK & ~(c); P6OUT &= ~((c) & DR_LED_MASK); }	//single bis/bic, P6 also drives the contactors
 
 
 
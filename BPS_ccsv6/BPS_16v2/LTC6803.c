@@ -16,6 +16,7 @@
 #include <msp430x54xa.h>
 #include "BPSmain.h"
 #include "LTC6803.h"
+#include "flash.h"
  
 // Global Variables
 static const unsigned char InitialPEC = 0x41;
@@ -23,6 +24,11 @@ static const unsigned char InitialPEC = 0x41;
 extern volatile int ltc1_cv[12];
 extern volatile int ltc2_cv[12];
 extern volatile int ltc3_cv[12];
+
+//per-cell calibration, identity until LTC_cal_load finds a table
+ltc_cal_table ltc_cal;
+unsigned char ltc_cal_valid = FALSE;
+static int LTC_cal_apply(unsigned char ltc, unsigned char ch, int raw);
 	
 static const unsigned char LTADDR = 0x80;
 static const unsigned char LTADDR_PEC= 0x49;
@@ -49,7 +55,7 @@ char LTC1_init(void) {
 	LTC1_Config();
 	read_error = LTC1_Read_Config();
 	
-	if(read_error==1) {LED_ERROR_ON;}
+	if(read_error!=0) {LED_ERROR_ON;}
 	else {LED_ERROR_OFF;}
 
 	return(read_error);
@@ -65,7 +71,7 @@ char LTC2_init(void) {
 	LTC2_Config();
 	read_error = LTC2_Read_Config();
 	
-	if(read_error==1) {LED_ERROR_ON;}
+	if(read_error!=0) {LED_ERROR_ON;}
 	else {LED_ERROR_OFF;}
 	return(read_error);
 }
@@ -81,12 +87,110 @@ char LTC3_init(void)
 	LTC3_Config();
 	read_error = LTC3_Read_Config();
 	
-	if(read_error==1) {LED_ERROR_ON;}
+	if(read_error!=0) {LED_ERROR_ON;}
 	else {LED_ERROR_OFF;}
 	return(read_error);
 }
 
 
+/*
+ * Brings up all three LTC ports and writes each configuration once, back to back
+ *	- Nothing waits here, LTC_verify_all reads them back later, after the ADC
+ *	  calibration, which gives the LTCs their settling time
+ */
+void LTC_start_all(void)
+{
+	LTC1SPI_init();
+	LTC2SPI_init();
+	LTC3SPI_init();
+	LTC1_Config();
+	LTC2_Config();
+	LTC3_Config();
+}
+
+/*
+ * Reads back the configurations, rewrites any that do not match and reads again
+ *	- Replaces calling LTCn_init twice: an LTC that missed the first write
+ *	  (still waking from standby) is written again only if it needs it
+ *	- Returns a bit per LTC that still fails: 0x01 LTC1, 0x02 LTC2, 0x04 LTC3
+ */
+unsigned char LTC_verify_all(void)
+{
+	unsigned char failed = 0x07;
+	char n;
+
+	for(n = 0; (n < LTC_INIT_TRIES) && (failed != 0x00); n++)
+	{
+		if(n != 0)
+		{
+			if(failed & 0x01) LTC1_Config();
+			if(failed & 0x02) LTC2_Config();
+			if(failed & 0x04) LTC3_Config();
+		}
+		if((failed & 0x01) && (LTC1_Read_Config() == 0)) failed &= ~0x01;
+		if((failed & 0x02) && (LTC2_Read_Config() == 0)) failed &= ~0x02;
+		if((failed & 0x04) && (LTC3_Read_Config() == 0)) failed &= ~0x04;
+	}
+	return(failed);
+}
+
+/*
+ * Loads the cell calibration table from info flash C, at reset
+ *	- A blank or corrupt table leaves the identity (no correction)
+ */
+void LTC_cal_load(void)
+{
+	const ltc_cal_table *f = (const ltc_cal_table *) LTC_CAL_ADDR;
+
+	if((f->tag == LTC_CAL_TAG) && (f->check == flash_check(f, LTC_CAL_CHECK_WORDS)))
+	{
+		ltc_cal = *f;
+		ltc_cal_valid = TRUE;
+	}
+	else
+	{
+		LTC_cal_clear();
+	}
+}
+
+/*
+ * Identity calibration in RAM, flash is not changed until LTC_cal_save
+ */
+void LTC_cal_clear(void)
+{
+	unsigned char n, ch;
+
+	ltc_cal.tag = LTC_CAL_TAG;
+	for(n = 0; n < 3; n++)
+	{
+		for(ch = 0; ch < 12; ch++)
+		{
+			ltc_cal.gain[n][ch] = 0;
+			ltc_cal.offset[n][ch] = 0;
+		}
+	}
+	ltc_cal_valid = FALSE;
+}
+
+/*
+ * Writes the RAM table to info flash C (segment erase, ~25 ms with the CPU held)
+ */
+void LTC_cal_save(void)
+{
+	ltc_cal.tag = LTC_CAL_TAG;
+	ltc_cal.check = flash_check(&ltc_cal, LTC_CAL_CHECK_WORDS);
+	flash_write((void *) LTC_CAL_ADDR, &ltc_cal, sizeof(ltc_cal) / 2, TRUE);
+	ltc_cal_valid = TRUE;
+}
+
+/*
+ * Corrected code of channel ch of LTC ltc (0..2), one multiply
+ */
+static int LTC_cal_apply(unsigned char ltc, unsigned char ch, int raw)
+{
+	return(raw + ltc_cal.offset[ltc][ch] + (int)((((long)(raw - 512) * ltc_cal.gain[ltc][ch]) + 16384) >> 15));
+}
+
 void LTC1_Config(void)
 {
 	unsigned char comp_PEC;
@@ -153,14 +257,14 @@ unsigned char LTC1_Read_Config(void)
 		if (READ_CFG[0] == CFGR0) return(0);
 		else
 		{
-			ltc1_errflag |= 0x10;
-			return(1);
+			ltc1_errflag |= LTC_ERR_CFG;
+			return(ltc1_errflag);
 		}
 	}
 	else
 	{
-		ltc1_errflag |= 0x40;
-		return(1);
+		ltc1_errflag |= LTC_ERR_PEC;
+		return(ltc1_errflag);
 	}
 }
 
@@ -230,14 +334,14 @@ unsigned char LTC2_Read_Config(void)
 		if (READ_CFG[0] == CFGR0) return(0);
 		else 
 		{
-			ltc2_errflag |= 0x20;
-			return(1);
+			ltc2_errflag |= LTC_ERR_CFG;
+			return(ltc2_errflag);
 		}
 	}
 	else
 	{
-		ltc2_errflag |= 0x80;
-		return(1);
+		ltc2_errflag |= LTC_ERR_PEC;
+		return(ltc2_errflag);
 	}
 }
 
@@ -307,14 +411,14 @@ unsigned char LTC3_Read_Config(void)
 		if (READ_CFG[0] == CFGR0) return(0);
 		else
 		{
-			LTC3_errflag |= 0x10;
-			return(1);
+			LTC3_errflag |= LTC_ERR_CFG;
+			return(LTC3_errflag);
 		}
 	}
 	else
 	{
-		LTC3_errflag |= 0x40;
-		return(1);
+		LTC3_errflag |= LTC_ERR_PEC;
+		return(LTC3_errflag);
 	}
 }
 
@@ -408,8 +512,8 @@ unsigned char LTC1_Read_Flags(void)
 	
 	if (READ_FLGR_PEC!=comp_PEC)
 	{
-		ltc1_errflag |= 0x40;
-		return(1);
+		ltc1_errflag |= LTC_ERR_PEC;
+		return(ltc1_errflag);
 	}
 	
 	OV_flag = (ltc1_FLGR[0] & 0xAA)>>1;
@@ -421,11 +525,10 @@ unsigned char LTC1_Read_Flags(void)
 	UV_flag |= (ltc1_FLGR[2] & 0x55);
 
 // Error flag conditions	
-	if(OV_flag != 0x00) ltc1_errflag |= 0x02;
-	if(UV_flag != 0x00) ltc1_errflag |= 0x01;
+	if(OV_flag != 0x00) ltc1_errflag |= LTC_ERR_OV;
+	if(UV_flag != 0x00) ltc1_errflag |= LTC_ERR_UV;
 	
-	if (ltc1_errflag == 0x00) return(0);
-	else return(1);
+	return(ltc1_errflag);
 }
 
 unsigned char LTC2_Read_Flags(void)
@@ -458,8 +561,8 @@ unsigned char LTC2_Read_Flags(void)
 	
 	if (READ_FLGR_PEC!=comp_PEC)
 	{
-		ltc2_errflag |= 0x80;
-		return(1);
+		ltc2_errflag |= LTC_ERR_PEC;
+		return(ltc2_errflag);
 	}
 	
 	OV_flag = (ltc2_FLGR[0] & 0xAA)>>1;
@@ -471,11 +574,10 @@ unsigned char LTC2_Read_Flags(void)
 	UV_flag |= (ltc2_FLGR[2] & 0x55);
 
 // Error flag conditions	
-	if(OV_flag != 0x00) ltc2_errflag |= 0x08;
-	if(UV_flag != 0x00) ltc2_errflag |= 0x04;
+	if(OV_flag != 0x00) ltc2_errflag |= LTC_ERR_OV;
+	if(UV_flag != 0x00) ltc2_errflag |= LTC_ERR_UV;
 
-	if (ltc2_errflag == 0x00) return(0);
-	else return(1);
+	return(ltc2_errflag);
 }
 
 unsigned char LTC3_Read_Flags(void)
@@ -508,8 +610,8 @@ unsigned char LTC3_Read_Flags(void)
 	
 	if (READ_FLGR_PEC!=comp_PEC)
 	{
-		ltc3_errflag |= 0x40;
-		return(1);
+		ltc3_errflag |= LTC_ERR_PEC;
+		return(ltc3_errflag);
 	}
 	
 	OV_flag = (LTC3_FLGR[0] & 0xAA)>>1;
@@ -521,11 +623,10 @@ unsigned char LTC3_Read_Flags(void)
 	UV_flag |= (LTC3_FLGR[2] & 0x55);
 
 // Error flag conditions
-	if(OV_flag != 0x00) ltc3_errflag |= 0x02;
-	if(UV_flag != 0x00) ltc3_errflag |= 0x01;
+	if(OV_flag != 0x00) ltc3_errflag |= LTC_ERR_OV;
+	if(UV_flag != 0x00) ltc3_errflag |= LTC_ERR_UV;
 	
-	if (ltc3_errflag == 0x00) return(0);
-	else return(1);
+	return(ltc3_errflag);
 }
 
 void LTC1_Clear_ADCCV(void)		// Command require 1 msec to operate
@@ -574,16 +675,14 @@ unsigned char LTC1_Read_Voltages(void)
 	
 	if (READ_CVR_PEC!=comp_PEC)
 	{
-		ltc1_errflag |= 0x40;
-		return(1);
+		ltc1_errflag |= LTC_ERR_PEC;
+		return(ltc1_errflag);
 	}
 	
 	for (i=0;i<=5;i++)
 	{
-		ltc1_cv[2*i]  = ((int)(READ_CVR[3*i+1] & 0x0F))<<8;
-		ltc1_cv[2*i] |= (int)READ_CVR[3*i];
-		ltc1_cv[2*i+1]  = ((int)READ_CVR[3*i+2])<<4;
-		ltc1_cv[2*i+1] |= ((int)(READ_CVR[3*i+1] & 0xF0))>>4;
+		ltc1_cv[2*i] = LTC_cal_apply(0, 2*i, (((int)(READ_CVR[3*i+1] & 0x0F))<<8) | (int)READ_CVR[3*i]);
+		ltc1_cv[2*i+1] = LTC_cal_apply(0, 2*i+1, (((int)READ_CVR[3*i+2])<<4) | (((int)(READ_CVR[3*i+1] & 0xF0))>>4));
 	}
 	
 	return(0);
@@ -635,16 +734,14 @@ unsigned char LTC2_Read_Voltages(void)
 	
 	if (READ_CVR_PEC!=comp_PEC)
 	{
-		ltc2_errflag |= 0x80;
-		return(1);
+		ltc2_errflag |= LTC_ERR_PEC;
+		return(ltc2_errflag);
 	}
 	
 	for (i=0;i<=5;i++)
 	{
-		ltc2_cv[2*i]  = ((int)(READ_CVR[3*i+1] & 0x0F))<<8;
-		ltc2_cv[2*i] |= (int)READ_CVR[3*i];
-		ltc2_cv[2*i+1]  = ((int)READ_CVR[3*i+2])<<4;
-		ltc2_cv[2*i+1] |= ((int)(READ_CVR[3*i+1] & 0xF0))>>4;
+		ltc2_cv[2*i] = LTC_cal_apply(1, 2*i, (((int)(READ_CVR[3*i+1] & 0x0F))<<8) | (int)READ_CVR[3*i]);
+		ltc2_cv[2*i+1] = LTC_cal_apply(1, 2*i+1, (((int)READ_CVR[3*i+2])<<4) | (((int)(READ_CVR[3*i+1] & 0xF0))>>4));
 	}
 	
 	return(0);
@@ -696,16 +793,14 @@ unsigned char LTC3_Read_Voltages(void)
 	
 	if (READ_CVR_PEC!=comp_PEC)
 	{
-		LTC3_errflag |= 0x40;
-		return(1);
+		LTC3_errflag |= LTC_ERR_PEC;
+		return(LTC3_errflag);
 	}
 	
 	for (i=0;i<=5;i++)
 	{
-		ltc3_cv[2*i]  = ((int)(READ_CVR[3*i+1] & 0x0F))<<8;
-		ltc3_cv[2*i] |= (int)READ_CVR[3*i];
-		ltc3_cv[2*i+1]  = ((int)READ_CVR[3*i+2])<<4;
-		ltc3_cv[2*i+1] |= ((int)(READ_CVR[3*i+1] & 0xF0))>>4;
+		ltc3_cv[2*i] = LTC_cal_apply(2, 2*i, (((int)(READ_CVR[3*i+1] & 0x0F))<<8) | (int)READ_CVR[3*i]);
+		ltc3_cv[2*i+1] = LTC_cal_apply(2, 2*i+1, (((int)READ_CVR[3*i+2])<<4) | (((int)(READ_CVR[3*i+1] & 0xF0))>>4));
 	}
 	
 
@@ -750,8 +845,8 @@ unsigned char LTC1_Read_TempReg(void)
 	
 	if (READ_TMPR_PEC!=comp_PEC)
 	{
-		ltc1_errflag |= 0x40;
-		return(1);
+		ltc1_errflag |= LTC_ERR_PEC;
+		return(ltc1_errflag);
 	}
 	
 	ltc1_ETMP[0]  = ((int)(READ_TMPR[1] & 0x0F))<<8;
@@ -801,8 +896,8 @@ unsigned char LTC2_Read_TempReg(void)
 	
 	if (READ_TMPR_PEC!=comp_PEC)
 	{
-		ltc2_errflag |= 0x80;
-		return(1);
+		ltc2_errflag |= LTC_ERR_PEC;
+		return(ltc2_errflag);
 	}
 	
 	ltc2_ETMP[0]  = ((int)(READ_TMPR[1] & 0x0F))<<8;
@@ -852,8 +947,8 @@ unsigned char LTC3_Read_TempReg(void)
 	
 	if (READ_TMPR_PEC!=comp_PEC)
 	{
-		LTC3_errflag |= 0x40;
-		return(1);
+		LTC3_errflag |= LTC_ERR_PEC;
+		return(LTC3_errflag);
 	}
 	
 	LTC3_ETMP[0]  = ((int)(READ_TMPR[1] & 0x0F))<<8;
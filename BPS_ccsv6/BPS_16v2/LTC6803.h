@@ -47,6 +47,38 @@ unsigned char LTC3_Read_Voltages(void);
 void LTC3_Start_ADCTEMP(void);
 unsigned char LTC3_Read_TempReg(void);
 
+// LTCn_Read_Config / Read_Flags / Read_Voltages return value bits, 0 = good
+// All three LTCs must set the same bits, ltc_status_level tests them without knowing the LTC
+#define LTC_ERR_UV			0x01		// A cell under Vuv (flag register)
+#define LTC_ERR_OV			0x02		// A cell over Vov (flag register)
+#define LTC_ERR_CFG			0x10		// Configuration did not read back
+#define LTC_ERR_PEC			0x40		// Packet error code mismatch
+
+void LTC_start_all(void);
+unsigned char LTC_verify_all(void);
+#define LTC_INIT_TRIES		3		// Config write + readback attempts per LTC in LTC_verify_all
+
+// Per-cell calibration, applied to the codes as LTCn_Read_Voltages unpacks them:
+//	code = raw + offset + ( raw - 512 ) * gain / 2^15
+void LTC_cal_load(void);
+void LTC_cal_clear(void);
+void LTC_cal_save(void);
+#define LTC_CAL_ADDR		0x1880		// Info flash C
+#define LTC_CAL_TAG			0xCA11
+#define LTC_CAL_GAIN_MAX	1000		// |gain| limit, ~3 %
+
+typedef struct _ltc_cal_table
+{
+  unsigned int		tag;				// LTC_CAL_TAG
+  int				gain[3][12];		// Q15 gain error per LTC and channel
+  signed char		offset[3][12];		// Offset (codes, 1.5 mV)
+  unsigned int		check;				// ~sum of the words before it
+} ltc_cal_table;
+#define LTC_CAL_CHECK_WORDS	((sizeof(ltc_cal_table) / 2) - 1)	// Words under check
+
+extern ltc_cal_table ltc_cal;
+extern unsigned char ltc_cal_valid;		// Table loaded from flash (else identity)
+
 unsigned char Calculate_PEC(unsigned char theCommand, unsigned char CurrentPEC);
 unsigned int get_cell_voltage(char cell, char ltc);
 
@@ -8,9 +8,53 @@
 
 // Include files
 #include<msp430x54xa.h>
+#include <string.h>
 #include "BPSmain.h"
 #include "RS232.h"
 
+// Transmit ring buffer, filled by BPS2PC_puts/putchar, emptied by the UCA3 TX interrupt
+static char					pc_tx_buf[PC_TX_SIZE];
+static volatile unsigned int	pc_tx_head = 0;			// Next free slot (main loop)
+static volatile unsigned int	pc_tx_tail = 0;			// Next byte to send (TX ISR)
+static volatile unsigned char	pc_tx_idle = TRUE;		// Nothing in TXBUF, the next write has to start the transmitter
+volatile unsigned int		pc_tx_drop = 0;			// Lines (or characters) discarded, ring full
+volatile unsigned int		pc_tx_peak = 0;			// Most bytes ever queued
+
+
+// Receive ring buffer, filled by the UCA3 RX interrupt, emptied by BPS2PC_getline
+static char					pc_rx_buf[PC_RX_SIZE];
+static volatile unsigned char	pc_rx_head = 0;			// Next free slot (RX ISR)
+static volatile unsigned char	pc_rx_tail = 0;			// Next byte to read (main loop)
+volatile unsigned int		pc_rx_drop = 0;			// Characters discarded, ring full
+
+// Command line being assembled by BPS2PC_getline
+static char					pc_line[PC_LINE_SIZE];
+static unsigned char		pc_line_len = 0;
+static unsigned char		pc_line_long = FALSE;	// Line overran pc_line, discard at CR
+
+static int pc_tx_write(const char *data, unsigned int len, unsigned char crlf);
+
+// Baud rate check, timing model in RS232.h
+#define PC_OUT_OF_SPEC(t, n)	((PC_BIT_ERR(t, n) > PC_MAX_ERR) || (PC_BIT_ERR(t, n) < -PC_MAX_ERR))
+
+#if (PC_UCBR < 3) || (PC_UCBR > 0xFFFF)
+#error "PC_BAUD cannot be generated from PC_CLK_RATE"
+#endif
+#if PC_OUT_OF_SPEC(PC_T0, 1) || PC_OUT_OF_SPEC(PC_T1, 2) || PC_OUT_OF_SPEC(PC_T2, 3) || PC_OUT_OF_SPEC(PC_T3, 4) || \
+	PC_OUT_OF_SPEC(PC_T4, 5) || PC_OUT_OF_SPEC(PC_T5, 6) || PC_OUT_OF_SPEC(PC_T6, 7) || PC_OUT_OF_SPEC(PC_T7, 8) || \
+	PC_OUT_OF_SPEC(PC_T8, 9) || PC_OUT_OF_SPEC(PC_T9, 10)
+#error "PC_BAUD bit timing error above PC_MAX_ERR, raise PC_CLK_RATE or lower PC_BAUD"
+#endif
+
+static unsigned char pc_fmt_udec(unsigned long v, char *p, unsigned char min_digits);
+
+// Powers of ten for the decimal formatter
+static const unsigned long pc_pow10[10] =
+{
+	1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+	10000UL, 1000UL, 100UL, 10UL, 1UL
+};
+
 /*********************************************************************************/
 // BPS to PC External RS-232 (voltage isolated)
 /*********************************************************************************/
@@ -18,21 +62,25 @@ void BPS2PC_init(void)
 {
     UCA3CTL1 |= UCSWRST;                      // **Put state machine in reset**
     UCA3CTL1 |= UCSSEL_2;                     // SMCLK
-//    UCA3BRW = 833;                            // 8 MHz 9600 (see User's Guide)
-    UCA3BRW = 208;                            // 8 MHz 38400 (see User's Guide)
-    UCA3MCTL |= UCBRS_1 + UCBRF_0;            // Modulation UCBRSx=1, UCBRFx=0
+    UCA3BRW = PC_UCBR;                        // PC_BAUD from PC_CLK_RATE, see RS232.h
+    UCA3MCTL = PC_UCMCTL;                     // Modulation UCBRSx, low frequency mode
 	
 	UCA3IFG &= ~UCTXIFG;			//Clear Xmit and Rec interrupt flags
 	UCA3IFG &= ~UCRXIFG;
 	UCA3CTL1 &= ~UCSWRST;			// initalize state machine
+	UCA3IE &= ~UCTXIE;
+	pc_tx_idle = TRUE;				// UCTXIFG is clear, queued bytes wait for the next pc_tx_write
 //	UCA3ABCTL |= UCABDEN;			// automatic baud rate 
 //  UCA3IE |= UCRXIE|UCTXIE;		//enable TX & RX interrupt
 }
 
+/*
+ * Queues one character for transmission
+ *	- Never waits, the character is dropped (and counted) if the ring is full
+ */
 void BPS2PC_putchar(char data)
 {
-    while((UCA3IFG & UCTXIFG) == 0);
-    UCA3TXBUF = data; 
+	pc_tx_write(&data, 1, FALSE);
 }
 
 unsigned char BPS2PC_getchar(void)
@@ -46,22 +94,25 @@ unsigned char BPS2PC_getchar(void)
     return(UCA3RXBUF);
 }
 
-int BPS2PC_puts(char *str)
+/*
+ * Queues a string followed by LF CR
+ *	- Never waits: the whole line is dropped (and counted) if it does not fit,
+ *	  so the PC never receives half a line
+ *	- Returns the number of characters queued from str, 0 if dropped
+ */
+int BPS2PC_puts(const char *str)
 {
-	int i;
-    char ch;
-    i = 0;
+	return(pc_tx_write(str, strlen(str), TRUE));
+}
 
-    while((ch=*str)!= '\0')
-    {
-    	BPS2PC_putchar(ch);
-    	str++;
-    	i++;
-    }
-    BPS2PC_putchar(0x0A);
-    BPS2PC_putchar(0x0D);
-    
-    return(i);
+/*
+ * Queues len raw bytes (binary data, no line ending)
+ *	- Never waits: the whole block is dropped (and counted) if it does not fit
+ *	- Returns len, 0 if dropped
+ */
+int BPS2PC_write(const char *data, unsigned int len)
+{
+	return(pc_tx_write(data, len, FALSE));
 }
 
 int BPS2PC_gets(char *ptr)
@@ -82,24 +133,251 @@ int BPS2PC_gets(char *ptr)
      }
 }
 
+/*
+ * UCA3 TX interrupt handler, call from USCI_A3_ISR on UCTXIFG
+ *	- Sends the next queued byte, disables the TX interrupt when the ring is empty
+ *	- Reading UCA3IV has cleared UCTXIFG, and it only sets again after a TXBUF
+ *	  write, so an empty ring leaves the transmitter idle for pc_tx_write to restart
+ */
 void BPS2PC_put_int(void)
 {
-    extern char *putPC_ptr;
-    extern char put_status_PC;
-    char ch;
-    
-    ch = *putPC_ptr++;
+	unsigned int tail;
 
-	if (ch == '\0')
+	tail = pc_tx_tail;
+	if (tail == pc_tx_head)
 	{
 		UCA3IE &= ~UCTXIE;
-		put_status_PC = FALSE;
+		pc_tx_idle = TRUE;
 	}
 	else
 	{
-		UCA3TXBUF = ch;
-		UCA3IE |= UCTXIE;
-		put_status_PC = TRUE;
+		UCA3TXBUF = pc_tx_buf[tail];
+		pc_tx_tail = (tail + 1) & (PC_TX_SIZE - 1);
+	}
+}
+
+/*
+ * Integer formatter
+ *	- Each call writes straight into the TX ring, finish the line with BPS2PC_puts
+ *	- No sprintf and no floating point: digits come from subtracting powers of ten,
+ *	  which avoids the 32-bit divide library call
+ */
+void BPS2PC_put_str(const char *str)
+{
+	pc_tx_write(str, strlen(str), FALSE);
+}
+
+void BPS2PC_put_udec(unsigned long v)
+{
+	char buf[10];
+
+	pc_tx_write(buf, pc_fmt_udec(v, buf, 1), FALSE);
+}
+
+void BPS2PC_put_dec(long v)
+{
+	char buf[11];
+	unsigned char n = 0;
+
+	if(v < 0)
+	{
+		buf[n++] = '-';
+		v = -v;
+	}
+	n += pc_fmt_udec((unsigned long) v, &buf[n], 1);
+	pc_tx_write(buf, n, FALSE);
+}
+
+/*
+ * Prints a fixed point value, v in units of 10^-decimals (e.g. mV with decimals = 3)
+ */
+void BPS2PC_put_fixed(long v, unsigned char decimals)
+{
+	char buf[12];
+	unsigned char n = 0, digits, i;
+
+	if(v < 0)
+	{
+		buf[n++] = '-';
+		v = -v;
 	}
+	digits = pc_fmt_udec((unsigned long) v, &buf[n], decimals + 1);
+	if(decimals > 0)
+	{
+		// Open a gap for the decimal point in front of the last 'decimals' digits
+		for(i = 0; i < decimals; i++) buf[n + digits - i] = buf[n + digits - i - 1];
+		buf[n + digits - decimals] = '.';
+		digits++;
+	}
+	pc_tx_write(buf, n + digits, FALSE);
 }
 
+/*
+ * Prints the low 'digits' hex digits of v (1..8)
+ */
+void BPS2PC_put_hex(unsigned long v, unsigned char digits)
+{
+	char buf[8];
+	unsigned char i, d;
+
+	if(digits > 8) digits = 8;
+	for(i = digits; i > 0; i--)
+	{
+		d = (unsigned char)(v & 0x0F);
+		buf[i - 1] = (d < 10) ? ('0' + d) : ('A' - 10 + d);
+		v >>= 4;
+	}
+	pc_tx_write(buf, digits, FALSE);
+}
+
+/*
+ * Converts v to decimal digits in p, zero padded to at least min_digits
+ *	- Returns the number of digits written (at most 10)
+ */
+static unsigned char pc_fmt_udec(unsigned long v, char *p, unsigned char min_digits)
+{
+	unsigned char i, n = 0;
+	char d;
+
+	for(i = 0; i < 10; i++)
+	{
+		d = '0';
+		while(v >= pc_pow10[i])
+		{
+			v -= pc_pow10[i];
+			d++;
+		}
+		if((n > 0) || (d != '0') || (i >= 10 - min_digits)) p[n++] = d;
+	}
+	return(n);
+}
+
+/*
+ * UCA3 RX interrupt handler, call from USCI_A3_ISR on UCRXIFG
+ *	- Only stores the byte, line editing and echo happen in BPS2PC_getline
+ */
+void BPS2PC_get_int(void)
+{
+	unsigned char head, next;
+	char ch;
+
+	ch = UCA3RXBUF;								//reading clears UCRXIFG
+	head = pc_rx_head;
+	next = (head + 1) & (PC_RX_SIZE - 1);
+	if(next == pc_rx_tail)
+	{
+		pc_rx_drop++;
+	}
+	else
+	{
+		pc_rx_buf[head] = ch;
+		pc_rx_head = next;
+	}
+}
+
+/*
+ * Assembles a command line from the receive ring, run from the main loop
+ *	- Echoes characters, handles backspace (0x08 or 0x7F)
+ *	- Characters past PC_LINE_SIZE - 1 are not stored, and the line is discarded at CR
+ *	- Returns the NUL terminated line when CR is received, otherwise 0
+ */
+char *BPS2PC_getline(void)
+{
+	char ch;
+
+	while(pc_rx_tail != pc_rx_head)
+	{
+		ch = pc_rx_buf[pc_rx_tail];
+		pc_rx_tail = (pc_rx_tail + 1) & (PC_RX_SIZE - 1);
+
+		if(ch == 0x0D)							//if return
+		{
+			BPS2PC_putchar(0x0A);				//new line
+			BPS2PC_putchar(0x0D);				//return
+			pc_line[pc_line_len] = '\0';
+			pc_line_len = 0;
+			if(pc_line_long)
+			{
+				pc_line_long = FALSE;
+				BPS2PC_puts("Line too long");
+				return(0);
+			}
+			return(pc_line);
+		}
+		else if((ch == 0x7F) || (ch == 0x08))	//if backspace
+		{
+			if(pc_line_len > 0)
+			{
+				pc_line_len--;
+				BPS2PC_putchar(ch);
+			}
+		}
+		else if(pc_line_len < (PC_LINE_SIZE - 1))
+		{
+			pc_line[pc_line_len++] = ch;
+			BPS2PC_putchar(ch);
+		}
+		else
+		{
+			pc_line_long = TRUE;
+		}
+	}
+	return(0);
+}
+
+/*
+ * Returns the number of bytes waiting to be sent
+ */
+unsigned int BPS2PC_tx_pending(void)
+{
+	return((pc_tx_head - pc_tx_tail) & (PC_TX_SIZE - 1));
+}
+
+/*
+ * Copies len bytes (plus LF CR if crlf) into the TX ring and starts the TX interrupt
+ *	- Interrupts are held off while copying, so a write from an ISR cannot interleave
+ *	  and the TX ISR never sees a partly written line
+ *	- Returns len, or 0 (counted in pc_tx_drop) if it does not all fit
+ */
+static int pc_tx_write(const char *data, unsigned int len, unsigned char crlf)
+{
+	unsigned int pos, used, total;
+	unsigned short sr;
+
+	total = crlf ? (len + 2) : len;
+
+	sr = __get_SR_register();
+	_DINT();
+	used = (pc_tx_head - pc_tx_tail) & (PC_TX_SIZE - 1);
+	if(used + total > PC_TX_SIZE - 1)
+	{
+		pc_tx_drop++;
+		__bis_SR_register(sr & GIE);
+		return(0);
+	}
+	pos = pc_tx_head;
+	while(len--)
+	{
+		pc_tx_buf[pos] = *data++;
+		pos = (pos + 1) & (PC_TX_SIZE - 1);
+	}
+	if(crlf)
+	{
+		pc_tx_buf[pos] = 0x0A;
+		pos = (pos + 1) & (PC_TX_SIZE - 1);
+		pc_tx_buf[pos] = 0x0D;
+		pos = (pos + 1) & (PC_TX_SIZE - 1);
+	}
+	pc_tx_head = pos;
+	used += total;
+	if(used > pc_tx_peak) pc_tx_peak = used;
+	if(pc_tx_idle && (pc_tx_tail != pc_tx_head))	//restart: first byte straight into TXBUF, UCTXIFG follows
+	{
+		pc_tx_idle = FALSE;
+		UCA3TXBUF = pc_tx_buf[pc_tx_tail];
+		pc_tx_tail = (pc_tx_tail + 1) & (PC_TX_SIZE - 1);
+	}
+	UCA3IE |= UCTXIE;							//keep the TX interrupt running
+	__bis_SR_register(sr & GIE);
+	return(total - (crlf ? 2 : 0));
+}
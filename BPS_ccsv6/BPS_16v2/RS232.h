@@ -17,9 +17,71 @@ void BPS2PC_putchar(char data);
 unsigned char BPS2PC_getchar(void);
 
 int BPS2PC_gets(char *ptr);
-int BPS2PC_puts(char *str);
+int BPS2PC_puts(const char *str);
+int BPS2PC_write(const char *data, unsigned int len);
+
+void BPS2PC_put_str(const char *str);
+void BPS2PC_put_udec(unsigned long v);
+void BPS2PC_put_dec(long v);
+void BPS2PC_put_fixed(long v, unsigned char decimals);
+void BPS2PC_put_hex(unsigned long v, unsigned char digits);
 
 void BPS2PC_put_int(void);
+unsigned int BPS2PC_tx_pending(void);
+void BPS2PC_get_int(void);
+char *BPS2PC_getline(void);
+
+/*
+ * UCA3 baud rate generator, computed at compile time from the UCA3 clock and PC_BAUD
+ *	- Select the rate per build by defining PC_BAUD in the project predefined symbols
+ *	- Low frequency mode only (UCOS16 = 0): N = PC_CLK_RATE / PC_BAUD, each bit is
+ *	  UCBRx = INT(N) clocks, plus one clock on the bits selected by UCBRSx = round(frac(N) * 8).
+ *	  With UCOS16 = 1 a UCBRSx bit adds UCBRx clocks and UCBRFx only whole clocks to
+ *	  every bit, never closer at these dividers
+ *	- PC_Tn is the length of bits 0..n in clocks, PC_BIT_ERR the error at the end of bit n
+ *	  in 0.01% of a bit. RS232.c stops the build when it is over PC_MAX_ERR anywhere in a
+ *	  10 bit character, BPS_ccsv6/tools/baud_check.c checks the macros on the host
+ *	- At SMCLK = 8 MHz: 38400 0.5%, 115200 0.8%, 230400 2.1%. 460800 needs SMCLK = 16 MHz (2.1%)
+ *	- The binary stream at every scan needs 115200, at 38400 use "stream on 2" or slower
+ */
+#ifndef PC_BAUD
+#define PC_BAUD			38400L			// PC link rate (bits/s)
+#endif
+#define PC_CLK_RATE		SMCLK_RATE		// UCA3 runs from SMCLK (Hz)
+
+#define PC_N128			((PC_CLK_RATE * 128L + PC_BAUD / 2) / PC_BAUD)		// N * 128, rounded
+#define PC_BRS_RND		(((PC_N128 % 128L) * 8L + 64L) / 128L)				// 0..8
+#define PC_UCBR			((PC_N128 / 128L) + ((PC_BRS_RND == 8) ? 1 : 0))
+#define PC_UCBRS		((PC_BRS_RND == 8) ? 0 : PC_BRS_RND)
+#define PC_UCMCTL		(PC_UCBRS << 1)						// UCBRFx = 0, UCOS16 = 0
+
+// UCBRSx modulation patterns (bit 7 = start bit), user's guide table 34-2
+#define PC_BRS_PAT		((PC_UCBRS == 0) ? 0x00 : (PC_UCBRS == 1) ? 0x40 : (PC_UCBRS == 2) ? 0x44 : \
+						 (PC_UCBRS == 3) ? 0x54 : (PC_UCBRS == 4) ? 0x55 : (PC_UCBRS == 5) ? 0x75 : \
+						 (PC_UCBRS == 6) ? 0x77 : 0x7F)
+#define PC_MOD(k)		((PC_BRS_PAT >> (7 - ((k) % 8))) & 1)
+#define PC_T0			(PC_UCBR + PC_MOD(0))
+#define PC_T1			(PC_T0 + PC_UCBR + PC_MOD(1))
+#define PC_T2			(PC_T1 + PC_UCBR + PC_MOD(2))
+#define PC_T3			(PC_T2 + PC_UCBR + PC_MOD(3))
+#define PC_T4			(PC_T3 + PC_UCBR + PC_MOD(4))
+#define PC_T5			(PC_T4 + PC_UCBR + PC_MOD(5))
+#define PC_T6			(PC_T5 + PC_UCBR + PC_MOD(6))
+#define PC_T7			(PC_T6 + PC_UCBR + PC_MOD(7))
+#define PC_T8			(PC_T7 + PC_UCBR + PC_MOD(8))
+#define PC_T9			(PC_T8 + PC_UCBR + PC_MOD(9))
+#define PC_BIT_ERR(t, n)	(((t) * PC_BAUD - (n) * PC_CLK_RATE) / (PC_CLK_RATE / 10000L))
+#define PC_MAX_ERR		300				// 3.00% of a bit
+
+// Transmit ring buffer (bytes, power of 2)
+#define PC_TX_SIZE		2048
+// Receive ring buffer (bytes, power of 2 up to 256) and command line length
+#define PC_RX_SIZE		64
+#define PC_LINE_SIZE	48
+
+extern volatile unsigned int pc_tx_drop;
+extern volatile unsigned int pc_tx_peak;
+extern volatile unsigned int pc_rx_drop;
 
 
 #endif /*RS232_PORTS_H_*/
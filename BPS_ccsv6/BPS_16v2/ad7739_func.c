@@ -15,6 +15,7 @@
 #include <msp430x54xa.h>
 #include "BPSmain.h"
 #include "ad7739_func.h"
+#include "probe.h"
 
 
 //#######################################################//
@@ -189,9 +190,9 @@ signed long adc_bus1_zselfcal(char adc_channel, char adc_device)	//Per channel z
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC1_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC2_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC3_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC1_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC2_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC3_RDY) != 0);
 
   if(adc_device==1) adc1_select;         
   if(adc_device==2) adc2_select;         
@@ -238,9 +239,9 @@ signed long adc_bus1_fselfcal(char adc_channel, char adc_device)	//Per channel z
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC1_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC2_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC3_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC1_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC2_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC3_RDY) != 0);
 
   if(adc_device==1) adc1_select;         
   if(adc_device==2) adc2_select;         
@@ -287,9 +288,9 @@ signed long adc_bus1_in(char adc_channel, char adc_device)	// read voltage from
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC1_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC2_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC3_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC1_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC2_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC3_RDY) != 0);
  
   //Read the ADC Data
   if(adc_device==1) adc1_select;         
@@ -335,9 +336,9 @@ signed long adc_bus1_indump(char adc_channel, char adc_device)	// read voltage f
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC1_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC2_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC3_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC1_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC2_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC3_RDY) != 0);
  
   //Read the ADC Data
   if(adc_device==1) adc1_select;         
@@ -679,9 +680,9 @@ signed long adc_bus2_zselfcal(char adc_channel, char adc_device)	//Per channel z
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC4_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC5_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC6_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC4_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC5_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC6_RDY) != 0);
 
   if(adc_device==1) adc4_select;
   if(adc_device==2) adc5_select;
@@ -728,9 +729,9 @@ signed long adc_bus2_fselfcal(char adc_channel, char adc_device)	//Per channel z
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC4_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC5_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC6_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC4_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC5_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC6_RDY) != 0);
 
   if(adc_device==1) adc4_select;
   if(adc_device==2) adc5_select;
@@ -777,9 +778,9 @@ signed long adc_bus2_in(char adc_channel, char adc_device)	// read voltage from
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC4_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC5_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC6_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC4_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC5_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC6_RDY) != 0);
  
   //Read the ADC Data
   if(adc_device==1) adc4_select;
@@ -825,9 +826,9 @@ signed long adc_bus2_indump(char adc_channel, char adc_device)	// read voltage f
   while (i != 0);
   
   //Wait for the conversion to be done
-  if(adc_device==1) while ( (P2IN & ADC4_RDY) == 1);
-  if(adc_device==2) while ( (P2IN & ADC5_RDY) == 1);
-  if(adc_device==3) while ( (P2IN & ADC6_RDY) == 1);
+  if(adc_device==1) while ( (P2IN & ADC4_RDY) != 0);
+  if(adc_device==2) while ( (P2IN & ADC5_RDY) != 0);
+  if(adc_device==3) while ( (P2IN & ADC6_RDY) != 0);
  
   //Read the ADC Data
   if(adc_device==1) adc4_select;
@@ -1513,7 +1514,67 @@ char adc_remote_temp_check(void)
 	return(terr);
 }
 
+/*================================== All ADC Functions ======================================*/
 
-	
+static void adc_dev_mode(char adc_device, char adc_channel, unsigned char adc_mode)	// MODE register write, device 1-7
+{
+  switch(adc_device)
+  {
+    case 1: adc1_select; adc_bus1_transmit(ADC_MODE0 | adc_channel); adc_bus1_transmit(adc_mode); adc1_deselect; break;
+    case 2: adc2_select; adc_bus1_transmit(ADC_MODE0 | adc_channel); adc_bus1_transmit(adc_mode); adc2_deselect; break;
+    case 3: adc3_select; adc_bus1_transmit(ADC_MODE0 | adc_channel); adc_bus1_transmit(adc_mode); adc3_deselect; break;
+    case 4: adc4_select; adc_bus2_transmit(ADC_MODE0 | adc_channel); adc_bus2_transmit(adc_mode); adc4_deselect; break;
+    case 5: adc5_select; adc_bus2_transmit(ADC_MODE0 | adc_channel); adc_bus2_transmit(adc_mode); adc5_deselect; break;
+    case 6: adc6_select; adc_bus2_transmit(ADC_MODE0 | adc_channel); adc_bus2_transmit(adc_mode); adc6_deselect; break;
+    case 7: adc7_select; adc_misc_transmit(ADC_MODE0 | adc_channel); adc_misc_transmit(adc_mode); adc7_deselect; break;
+  }
+}
 
+static unsigned char adc_wait_rdy(unsigned char rdy_mask)	// Wait for RDY low on every ADCn_RDY in the mask
+{
+  unsigned long start;
+  unsigned int i;
 
+  i = 32;		// Short SW Delay, RDY goes high after the MODE write
+  do i--;
+  while (i != 0);
+
+  start = probe_time();		// Interrupts are off in init_hw, the polling keeps probe_time counting overflows
+  while ( (P2IN & rdy_mask) != 0 )
+  {
+    if ( (probe_time() - start) >= ADC_CAL_TIMEOUT_US ) return(P2IN & rdy_mask);
+  }
+  return(0);
+}
+
+/*
+ * Self-calibration of all seven ADCs with the calibration waits overlapped
+ *	- Each round starts one channel's calibration on every device, then waits
+ *	  for all their RDY pins, so a round costs one calibration time, not seven
+ *	- Bus 1 and 2 get the zero-scale cal (as adc_busN_selfcal), the misc ADC zero
+ *	  and full-scale (as adc_misc_selfcal), its full-scale cals are the last 8 rounds
+ *	- Returns the ADCn_RDY bits of the devices that missed ADC_CAL_TIMEOUT_US
+ */
+char adc_selfcal_all(void)
+{
+  char ch, dev, late = 0;
+
+  for (ch = 0; ch <= 7; ch++)
+  {
+    for (dev = 1; dev <= 6; dev++) adc_dev_mode(dev, ch, MZSELFCAL | CLKDIS | BIT24_16n);
+    adc_dev_mode(7, ch, MZSELFCAL | CLKDIS | BIT24_16n | CLAMP);
+    late |= adc_wait_rdy(ADC1_RDY | ADC2_RDY | ADC3_RDY | ADC4_RDY | ADC5_RDY | ADC6_RDY | ADC7_RDY);
+    for (dev = 1; dev <= 3; dev++)
+    {
+      adc_bus1_idle(ch, dev);
+      adc_bus2_idle(ch, dev);
+    }
+  }
+
+  for (ch = 0; ch <= 7; ch++)
+  {
+    adc_dev_mode(7, ch, MFSELFCAL | CLKDIS | BIT24_16n | CLAMP);
+    late |= adc_wait_rdy(ADC7_RDY);
+  }
+  return(late);
+}
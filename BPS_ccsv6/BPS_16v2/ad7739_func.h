@@ -100,6 +100,10 @@ extern char adc_misc_chstatus(char adc_channel);
 extern char adc_misc_temp_check(void);
 extern char adc_misc_remote_temp_check(void);
 
+//ALL
+extern char adc_selfcal_all(void);
+#define ADC_CAL_TIMEOUT_US	10000			// One self-cal round, a calibration is ~2 ms at FWRATE 60
+
 // SPI port interface macros
 #define adc1_select		P4OUT &= ~ADC_CS1;
 #define adc1_deselect	P4OUT |= ADC_CS1;
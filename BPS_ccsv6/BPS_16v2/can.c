@@ -26,6 +26,7 @@
  *	- can_receive
  *
  * Modified for tranmist errors, B. Bazuin 7/2012
+ * Error state monitor and bus-off recovery added
  *
  */
 
@@ -35,9 +36,16 @@
 
 // Public variables
 can_variables			can;
+can_error_state			can_err = { CAN_ERR_ACTIVE, 0, 0, 0, 0, 0, 0, 0, 0, CAN_BACKOFF_MIN, 0 };
 
 // Private variables
 unsigned char 			buffer[16];
+static unsigned int		buf_addr[3] = {0xFFFF, 0xFFFF, 0xFFFF};	// Address loaded in each TX mailbox
+static can_variables	rxq[CAN_RXQ_SIZE];							// Received message queue
+static unsigned int		rxq_tick[CAN_RXQ_SIZE];						// Tick each message was read
+static unsigned char	rxq_head = 0, rxq_tail = 0;
+unsigned int			can_rx_tick;								// Tick the last popped message was read
+unsigned int			can_rx_drop = 0;							// Messages left in the controller, queue full
 
 /**************************************************************************************************
  * PUBLIC FUNCTIONS
@@ -48,31 +56,37 @@ unsigned char 			buffer[16];
  *	- Resets MCP2515 via SPI port (switches to config mode, clears errors)
  *	- Changes CLKOUT to /4 rate (4 MHz)
  *	- Sets up bit timing
- *      - originally 1 Mbit operation
- *      - modified for 250 kbps operation (buffer[2] setting below)
+ *      - CNF1..CNF3 computed in can.h from CAN_OSC_FREQ and CAN_BITRATE (250 kbps default)
  *	- Sets up receive filters and masks
- *		- Rx Filter 0 = Motor controller velocity
- *		- Rx Filter 1 = Unused
- *		- Rx Filter 2 = Driver controls packets (for remote frame requests)
- *		- Rx Filter 3 = Unused
+ *		- Rx Filter 0 = Driver controls switch position
+ *		- Rx Filter 1 = Motor controller bus current/voltage
+ *		- Rx Filter 2 = BPS packets (for remote frame requests)
+ *		- Rx Filter 3 = Array controller packets (charge request, shunt current)
  *		- Rx Filter 4 = Unused
  *		- Rx Filter 5 = Unused
  *		- Rx Mask 0   = Exact message must match (all 11 bits)
  *		- Rx Mask 1   = Block address must match (upper 6 bits)
  *	- Enables ERROR and RX interrupts on IRQ pin
  *	- Switches to normal (operating) mode
+ *	- Forgets the cached mailbox addresses, the reset has cleared the TX buffers
  */
 void can_init( void )
 {
 	// Set up reset and clocking
 	can_reset();
+	buf_addr[0] = 0xFFFF;
+	buf_addr[1] = 0xFFFF;
+	buf_addr[2] = 0xFFFF;
+	can_err.state = CAN_ERR_ACTIVE;
+	can_err.eflg = 0x00;
+	can_err.tec = 0x00;
+	can_err.rec = 0x00;
 	can_mod( CANCTRL, 0x03, 0x02 );			// CANCTRL register, modify lower 2 bits, CLK = /4
 	
 	// Set up bit timing & interrupts
-	buffer[0] = 0x02;						// CNF3 register: PHSEG2 = 3Tq, No wakeup, CLKOUT = CLK
-	buffer[1] = 0xC9;						// CNF2 register: set PHSEG2 in CNF3, Triple sample, PHSEG1= 2Tq, PROP = 2Tq
-//	buffer[2] = 0x00;						// CNF1 register: SJW = 1Tq, BRP = 0 > 1Mbps
-	buffer[2] = 0x03;						// CNF1 register: SJW = 1Tq, BRP = 3 > 250 kbps
+	buffer[0] = CAN_CNF3_VAL;				// CNF3 register: PHSEG2, No wakeup, CLKOUT = CLK
+	buffer[1] = CAN_CNF2_VAL;				// CNF2 register: set PHSEG2 in CNF3, sampling, PHSEG1, PROP
+	buffer[2] = CAN_CNF1_VAL;				// CNF1 register: SJW, BRP
 	buffer[3] = 0xA3;						// CANINTE register: enable MERRE, ERROR, RX0 & RX1 interrupts on IRQ pin
 //	buffer[3] = 0x23;						// CANINTE register: enable ERROR, RX0 & RX1 interrupts on IRQ pin
 	buffer[4] = 0x00;						// CANINTF register: clear all IRQ flags
@@ -86,8 +100,8 @@ void can_init( void )
 	buffer[ 2] = 0x00;
 	buffer[ 3] = 0x00;
 	// RXF1 - Buffer 0
-	buffer[ 4] = (unsigned char)((AC_CAN_BASE + AC_BP_CHARGE) >> 3);
-	buffer[ 5] = (unsigned char)((AC_CAN_BASE + AC_BP_CHARGE) >> 3);
+	buffer[ 4] = (unsigned char)((MC_CAN_BASE1 + MC_BUS) >> 3);
+	buffer[ 5] = (unsigned char)((MC_CAN_BASE1 + MC_BUS) << 5);
 	buffer[ 6] = 0x00;
 	buffer[ 7] = 0x00;
 	// RXF2 - Buffer 1
@@ -98,8 +112,8 @@ void can_init( void )
 	can_write( RXF0SIDH, &buffer[0], 12 );
 	
 	// RXF3 - Buffer 1
-	buffer[ 0] = 0x00;
-	buffer[ 1] = 0x00;
+	buffer[ 0] = (unsigned char)((AC_CAN_BASE) >> 3);
+	buffer[ 1] = (unsigned char)((AC_CAN_BASE) << 5);
 	buffer[ 2] = 0x00;
 	buffer[ 3] = 0x00;
 	// RXF4 - Buffer 1
@@ -170,6 +184,8 @@ void can_receive( void )
 		can.data.data_u8[1] = buffer[0];	// EFLG
 		can.data.data_u8[2] = buffer[1];	// TEC
 		can.data.data_u8[3] = buffer[2];	// REC
+		can_err.err_cnt++;
+		can_error_update( buffer[0], buffer[1], buffer[2] );
 		// Clear the IRQ flag
 		can_mod( CANINTF, MCP_IRQ_ERR, 0x00 );
 	}
@@ -186,6 +202,8 @@ void can_receive( void )
 		can.data.data_u8[1] = buffer[0];	// EFLG
 		can.data.data_u8[2] = buffer[1];	// TEC
 		can.data.data_u8[3] = buffer[2];	// REC
+		can_err.err_cnt++;
+		can_error_update( buffer[0], buffer[1], buffer[2] );
 		// Clear the IRQ flag
 		can_mod( CANINTF, MCP_IRQ_MERR, 0x00 );
 	}
@@ -266,6 +284,8 @@ void can_receive( void )
   {
     can_read(EFLAG, &buffer[0], 1 );
     can_read(TEC, &buffer[1], 2 );
+    can_err.err_cnt++;
+    can_error_update( buffer[0], buffer[1], buffer[2] );
     // Clear error flags
     can_mod(EFLAG, buffer[0], 0x00 );	// Modify (to '0') all bits that were set
     // Clear the IRQ flag
@@ -274,6 +294,49 @@ void can_receive( void )
 	
 }
 
+/*
+ * Moves every pending message from the MCP2515 into the receive queue
+ *	- Run this routine when an IRQ is received
+ *	- Keeps reading while CAN_INTn is held low, so back-to-back frames are not left
+ *	  to overflow the two hardware buffers
+ *	- Stops when the queue is full, the remaining messages are counted in can_rx_drop
+ *	- Returns the number of messages queued
+ */
+int can_rx_drain( void )
+{
+	extern volatile unsigned int tick_count;
+	unsigned char next;
+	int n = 0;
+
+	while(( P2IN & CAN_INTn ) == 0x00 ){
+		next = ( rxq_head + 1 ) & ( CAN_RXQ_SIZE - 1 );
+		if( next == rxq_tail ){
+			can_rx_drop++;
+			break;
+		}
+		can_receive();
+		rxq[rxq_head] = can;
+		rxq_tick[rxq_head] = tick_count;
+		rxq_head = next;
+		n++;
+	}
+	return(n);
+}
+
+/*
+ * Takes the oldest message from the receive queue
+ *	- Copies it into the can structure and its read tick into can_rx_tick
+ *	- Returns 0 when the queue is empty
+ */
+int can_rx_pop( void )
+{
+	if( rxq_tail == rxq_head ) return(0);
+	can = rxq[rxq_tail];
+	can_rx_tick = rxq_tick[rxq_tail];
+	rxq_tail = ( rxq_tail + 1 ) & ( CAN_RXQ_SIZE - 1 );
+	return(1);
+}
+
 /*
  * Transmits a CAN message to the bus
  *	- Accepts address and data payload via can_interface structure
@@ -281,10 +344,10 @@ void can_receive( void )
  *	- Uses all available transmit buffers (3 available in CAN controller) to maximise throughput
  *	- Only modifies address information if it's different from what is already set up in CAN controller
  *	- Assumes constant 8-byte data length value
+ *	- Drops the message while the controller is bus-off
  */
 int can_transmit( void )
 {
-	static unsigned int buf_addr[3] = {0xFFFF, 0xFFFF, 0xFFFF};
 	extern unsigned char can_full;	//used for CAN transmission status
 	
 	// Fill data into buffer, it's used by any address
@@ -298,6 +361,12 @@ int can_transmit( void )
 	buffer[11] = can.data.data_u8[6];
 	buffer[12] = can.data.data_u8[7];
 
+	// Nothing can be sent until can_error_service() has brought the controller back
+	if( can_err.state == CAN_ERR_BUSOFF ){
+		can_full = TRUE;
+		return(0);
+	}
+
 	// Check if the incoming address has already been configured in a mailbox
 	if( can.address == buf_addr[0] ){
 		// Mailbox 0 setup matches our new message
@@ -384,6 +453,7 @@ int can_transmit( void )
 
 /*
  * Read CAN Status flags
+ *	- Also feeds the error monitor, in case an ERROR IRQ edge was missed
  */
 void can_flag_check( void )
 {
@@ -393,6 +463,66 @@ void can_flag_check( void )
 	// Check for errors
 	can_read( EFLAG, &can_FLAGS[0], 1 );
 	can_read( TEC, &can_FLAGS[1], 2 );
+	can_error_update( can_FLAGS[0], can_FLAGS[1], can_FLAGS[2] );
+}
+
+/*
+ * Updates the controller error state from EFLG, TEC and REC
+ *	- Counts transitions into error passive and bus-off, and receive overflows
+ *	- Entering bus-off starts the back-off timer for can_error_service()
+ */
+void can_error_update( unsigned char eflg, unsigned char tec, unsigned char rec )
+{
+	extern volatile unsigned int tick_count;
+	unsigned char state;
+
+	if(( eflg & MCP_EFLG_TXBO ) != 0x00 ) state = CAN_ERR_BUSOFF;
+	else if(( eflg & ( MCP_EFLG_TXEP | MCP_EFLG_RXEP )) != 0x00 ) state = CAN_ERR_PASSIVE;
+	else if(( eflg & MCP_EFLG_EWARN ) != 0x00 ) state = CAN_ERR_WARNING;
+	else state = CAN_ERR_ACTIVE;
+
+	if(( eflg & ( MCP_EFLG_RX0OVR | MCP_EFLG_RX1OVR )) != 0x00 ) can_err.overflow_cnt++;
+
+	if( state != can_err.state ){
+		if( state == CAN_ERR_PASSIVE ) can_err.passive_cnt++;
+		else if( state == CAN_ERR_BUSOFF ){
+			can_err.busoff_cnt++;
+			can_err.event_tick = tick_count;
+		}
+	}
+	// A bus-off already being recovered is only cleared by can_error_service()
+	if( can_err.state != CAN_ERR_BUSOFF ) can_err.state = state;
+
+	can_err.eflg = eflg;
+	can_err.tec = tec;
+	can_err.rec = rec;
+}
+
+/*
+ * Recovers the controller from bus-off
+ *	- Run this routine from the main loop
+ *	- Re-initialises the MCP2515 once the back-off has expired
+ *	- Back-off doubles on each bus-off that follows a recovery, up to CAN_BACKOFF_MAX,
+ *	  and returns to CAN_BACKOFF_MIN after CAN_BACKOFF_RESET ticks on the bus
+ *	- Returns 1 when the controller was re-initialised
+ */
+int can_error_service( void )
+{
+	extern volatile unsigned int tick_count;
+
+	if( can_err.state != CAN_ERR_BUSOFF ){
+		if(( can_err.backoff != CAN_BACKOFF_MIN ) && (( tick_count - can_err.event_tick ) >= CAN_BACKOFF_RESET )){
+			can_err.backoff = CAN_BACKOFF_MIN;
+		}
+		return(0);
+	}
+	if(( tick_count - can_err.event_tick ) < can_err.backoff ) return(0);
+
+	can_init();								// Clears TEC/REC and returns to error active
+	can_err.reinit_cnt++;
+	can_err.event_tick = tick_count;
+	if( can_err.backoff < CAN_BACKOFF_MAX ) can_err.backoff <<= 1;
+	return(1);
 }
 
 /**************************************************************************************************
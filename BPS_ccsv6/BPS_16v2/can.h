@@ -24,6 +24,8 @@
  *	- can_init
  *	- can_transmit
  *	- can_receive
+ *	- can_error_update, can_error_service (error state monitor, bus-off recovery)
+ *	- can_rx_drain, can_rx_pop (receive queue)
  *
  */
  
@@ -40,6 +42,10 @@ extern void 			can_init( void );
 extern int	 			can_transmit( void );
 extern void 			can_receive( void );
 extern void 			can_flag_check( void );
+extern void 			can_error_update( unsigned char eflg, unsigned char tec, unsigned char rec );
+extern int	 			can_error_service( void );
+extern int				can_rx_drain( void );
+extern int				can_rx_pop( void );
 
 	
 // Public variables
@@ -74,6 +80,29 @@ typedef struct _can_variables
 
 extern can_variables	can;
 
+// Controller error state, maintained from the ERROR IRQ and the periodic flag check
+typedef struct _can_error_state
+{
+  unsigned char		state;			// CAN_ERR_ACTIVE .. CAN_ERR_BUSOFF
+  unsigned char		eflg;			// Last EFLG register value
+  unsigned char		tec;			// Last transmit error counter
+  unsigned char		rec;			// Last receive error counter
+  unsigned int		err_cnt;		// ERROR/MERROR interrupts serviced
+  unsigned int		passive_cnt;	// Transitions into error passive
+  unsigned int		busoff_cnt;		// Transitions into bus-off
+  unsigned int		overflow_cnt;	// Receive buffer overflows
+  unsigned int		reinit_cnt;		// Controller re-initialisations after bus-off
+  unsigned int		backoff;		// Ticks to wait before the next re-initialisation
+  unsigned int		event_tick;		// Tick of the last bus-off or re-initialisation
+} can_error_state;
+
+extern can_error_state	can_err;
+
+// Receive queue, filled by can_rx_drain() and emptied by can_rx_pop()
+#define CAN_RXQ_SIZE		16			// Messages, power of 2
+extern unsigned int		can_rx_tick;
+extern unsigned int		can_rx_drop;
+
 // Private function prototypes
 void 					can_reset( void );
 void 					can_read( unsigned char address, unsigned char *ptr, unsigned char bytes );
@@ -92,6 +121,59 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 // Device serial number
 #define DEVICE_SERIAL	0x00000001
 
+/*
+ * CAN bit timing
+ *	- CNF1..CNF3 are computed at compile time from the MCP2515 oscillator and the bus rate
+ *	- Select the rate per build by defining CAN_BITRATE (125000, 250000, 500000 or 1000000)
+ *	  in the project predefined symbols. Every node on the car bus must use the same rate.
+ *	- Bit = SYNC (1 Tq) + PROP + PS1 + PS2, sample point is taken at the end of PS1
+ *	- Tq = 2 * (BRP + 1) / CAN_OSC_FREQ
+ */
+#define CAN_OSC_FREQ		16000000UL		// MCP2515 crystal (Hz)
+#ifndef CAN_BITRATE
+#define CAN_BITRATE			250000UL		// Car bus rate (bits/s)
+#endif
+#ifndef CAN_SAMPLE_PCT
+#define CAN_SAMPLE_PCT		75				// Target sample point (% of bit)
+#endif
+#define CAN_SJW				1				// Synchronisation jump width (Tq)
+
+// Largest number of Tq per bit (16, 12, 10 or 8) giving an integer prescaler
+#define CAN_TQ_FITS(n)		((CAN_OSC_FREQ % (2UL * CAN_BITRATE * (n))) == 0)
+#define CAN_NTQ				(CAN_TQ_FITS(16) ? 16 : CAN_TQ_FITS(12) ? 12 : CAN_TQ_FITS(10) ? 10 : CAN_TQ_FITS(8) ? 8 : 0)
+#define CAN_BRP				((CAN_OSC_FREQ / (2UL * CAN_BITRATE * CAN_NTQ)) - 1)
+
+// Segment lengths (Tq) for the target sample point
+#define CAN_PS2				(CAN_NTQ - ((CAN_NTQ * CAN_SAMPLE_PCT + 50) / 100))
+#define CAN_PROP			((CAN_NTQ - 1 - CAN_PS2) / 2)
+#define CAN_PS1				(CAN_NTQ - 1 - CAN_PS2 - CAN_PROP)
+#define CAN_SAMPLE_POINT	((100 * (1 + CAN_PROP + CAN_PS1)) / CAN_NTQ)	// Actual sample point (%)
+
+// Triple sampling only where the Tq is long enough for it (not at 1 Mbit)
+#define CAN_SAM				((CAN_BRP > 0) ? 1 : 0)
+
+#define CAN_CNF1_VAL		(((CAN_SJW - 1) << 6) | CAN_BRP)
+#define CAN_CNF2_VAL		(0x80 | (CAN_SAM << 6) | ((CAN_PS1 - 1) << 3) | (CAN_PROP - 1))
+#define CAN_CNF3_VAL		(CAN_PS2 - 1)
+
+// Check the computed timing against MCP2515 limits
+#if CAN_NTQ == 0
+#error "CAN_BITRATE cannot be generated from CAN_OSC_FREQ"
+#else
+#if (CAN_BRP > 63) || ((CAN_BRP + 1) * 2UL * CAN_NTQ * CAN_BITRATE != CAN_OSC_FREQ)
+#error "CAN baud rate prescaler out of range"
+#endif
+#if (CAN_PROP < 1) || (CAN_PROP > 8) || (CAN_PS1 < 1) || (CAN_PS1 > 8) || (CAN_PS2 < 2) || (CAN_PS2 > 8)
+#error "CAN bit segment out of range"
+#endif
+#if (CAN_PS2 > CAN_PROP + CAN_PS1) || (CAN_PS2 <= CAN_SJW)
+#error "CAN bit segments violate PS2 constraints"
+#endif
+#if (CAN_SAMPLE_POINT < 60) || (CAN_SAMPLE_POINT > 90)
+#error "CAN sample point out of range"
+#endif
+#endif
+
 // Status values (for message reception)
 #define CAN_ERROR		0xFFFF
 #define CAN_MERROR		0xFFFE
@@ -152,6 +234,14 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 #define BP_TMAX			    0x03		// High = Max. Temperature		    Low = Max. Temperature Cell         P=10s
 #define BP_PCDONE		    0x04		// High = "BPV2" or "0000" string	Low = CAN1_SERIAL Number			P=When Ready
 #define BP_ISH	 		    0x05		// High = Shunt Current		        Low = Battery Voltage        		P=1s
+#define BP_CANERR		    0x06		// High = State,EFLG,TEC,REC	    Low = Bus-off Count,Error Count		P=2s
+#define BP_IXCHK		    0x07		// High = Filtered Residual (mA)    Low = Status,Drift Count			P=2s
+#define BP_LIMITS		    0x08		// High = Discharge Current Limit (A) Low = Charge Current Limit (A)	P=200ms
+#define BP_PROBE		    0x09		// High = Probe Id,Top Bin,Avg (us) Low = Max (us),Min (us)			P=200ms, one probe per frame
+#define BP_SOC			    0x0A		// High = State of Charge (%)       Low = Charge Left (Ah)				P=2s
+#define BP_RCELL		    0x0B		// High = Cell Resistance (mOhm)    Low = Cell Num.						P=200ms, one cell per frame
+#define BP_TRISE		    0x0C		// High = Max. Temp. Rise (C/min)   Low = Sensor,Status,Warn Count		P=2s, 200ms while warning
+#define BP_PACKV		    0x0D		// High = SIG1 - LTC Sum (V)        Low = Status,Skipped Sweeps			P=2s, 200ms while stale or mismatched
 
 //Battery Protection System base address and packet offsets
 #define AC_CAN_BASE			0x5C0		// High = "ACV1" string or nulls    Low = CAN1_SERIAL Number            P=10s
@@ -312,6 +402,27 @@ void 					can_mod( unsigned char address, unsigned char mask, unsigned char data
 #define MCP_IRQ_RXB1	0x02
 #define MCP_IRQ_RXB0	0x01
 
+// MCP2515 Error flag register bit definitions
+#define MCP_EFLG_RX1OVR	0x80
+#define MCP_EFLG_RX0OVR	0x40
+#define MCP_EFLG_TXBO	0x20
+#define MCP_EFLG_TXEP	0x10
+#define MCP_EFLG_RXEP	0x08
+#define MCP_EFLG_TXWAR	0x04
+#define MCP_EFLG_RXWAR	0x02
+#define MCP_EFLG_EWARN	0x01
+
+// Controller error states (can_err.state)
+#define CAN_ERR_ACTIVE	0x00
+#define CAN_ERR_WARNING	0x01		// TEC or REC >= 96
+#define CAN_ERR_PASSIVE	0x02		// TEC or REC >= 128
+#define CAN_ERR_BUSOFF	0x03		// TEC > 255, controller off the bus
+
+// Bus-off recovery back-off (timer ticks), doubles on each repeat up to the maximum
+#define CAN_BACKOFF_MIN		2			// 20 ms
+#define CAN_BACKOFF_MAX		128			// 1.28 sec
+#define CAN_BACKOFF_RESET	500			// 5 sec without bus-off restores the minimum
+
 
 
 #endif /*CAN_H_*/
@@ -0,0 +1,627 @@
+/*
+ * RS232 command processor
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - Runs from the main loop, the USCI_A3 ISR only queues received bytes
+ * - To add a command, write a handler and insert it in command_table,
+ *   keeping the table sorted by name (strcmp order) for the binary search
+ *
+ */
+
+// Include files
+#include <string.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include "BPSmain.h"
+#include "command.h"
+#include "stream.h"
+#include "sched.h"
+#include "relay.h"
+#include "probe.h"
+#include "trip.h"
+#include "mode.h"
+#include "precharge.h"
+#include "i2t.h"
+#include "soc.h"
+#include "packv.h"
+#include "zero.h"
+#include "LTC6803.h"
+
+// Private function prototypes
+static void		cmd_battery_current( int argc, char **argv );
+static void		cmd_battery_state( int argc, char **argv );
+static void		cmd_battery_temps( int argc, char **argv );
+static void		cmd_battery_volts( int argc, char **argv );
+static void		cmd_cal_save( int argc, char **argv );
+static void		cmd_cal_set( int argc, char **argv );
+static void		cmd_cal_show( int argc, char **argv );
+static void		cmd_cal_channel( unsigned char cell, unsigned char *ltc, unsigned char *ch );
+static void		cmd_fault_clear( int argc, char **argv );
+static void		cmd_fault_show( int argc, char **argv );
+static void		cmd_help( int argc, char **argv );
+static void		cmd_i2t_show( int argc, char **argv );
+static void		cmd_trip_event( const char *label, const trip_event *e );
+static void		cmd_mode_show( int argc, char **argv );
+static void		cmd_packv_show( int argc, char **argv );
+static void		cmd_precharge_show( int argc, char **argv );
+static void		cmd_probe_hist( int argc, char **argv );
+static void		cmd_probe_reset( int argc, char **argv );
+static void		cmd_probe_stats( int argc, char **argv );
+static void		cmd_relay_state( int argc, char **argv );
+static void		cmd_soc_show( int argc, char **argv );
+static void		cmd_stream_off( int argc, char **argv );
+static void		cmd_stream_on( int argc, char **argv );
+static void		cmd_task_reset( int argc, char **argv );
+static void		cmd_task_stats( int argc, char **argv );
+static void		cmd_zero_show( int argc, char **argv );
+static const command_entry *command_find( const char *name );
+
+// Command table, sorted by name
+static const command_entry command_table[] =
+{
+	{ "battery current",	cmd_battery_current,	"shunt current" },
+	{ "battery state",		cmd_battery_state,		"BPS mode and link counters" },
+	{ "battery temps",		cmd_battery_temps,		"all thermistor temperatures" },
+	{ "battery volts",		cmd_battery_volts,		"all cell voltages" },
+	{ "cal save",			cmd_cal_save,			"write cell calibration to flash" },
+	{ "cal set",			cmd_cal_set,			"cell gain(ppm) offset(mV)" },
+	{ "cal show",			cmd_cal_show,			"cells with a calibration entry" },
+	{ "fault clear",		cmd_fault_clear,		"unlatch the trip record" },
+	{ "fault show",			cmd_fault_show,			"trips, times, marginal samples" },
+	{ "help",				cmd_help,				"list commands" },
+	{ "i2t show",			cmd_i2t_show,			"I2t heat, peak (% of trip), trips" },
+	{ "mode show",			cmd_mode_show,			"current mode, entry times since init" },
+	{ "packv show",			cmd_packv_show,			"LTC sum vs SIG1 pack voltage (V)" },
+	{ "precharge show",		cmd_precharge_show,		"last precharge fit and times (ms)" },
+	{ "probe hist",			cmd_probe_hist,			"n - time histogram of probe n" },
+	{ "probe reset",		cmd_probe_reset,		"clear execution time probes" },
+	{ "probe stats",		cmd_probe_stats,		"task/ISR time min avg max (us)" },
+	{ "relay state",		cmd_relay_state,		"contactor states and readback" },
+	{ "soc show",			cmd_soc_show,			"state of charge, rest, flash records" },
+	{ "stream off",			cmd_stream_off,			"stop binary telemetry" },
+	{ "stream on",			cmd_stream_on,			"[n] binary frame every n scans" },
+	{ "task reset",			cmd_task_reset,			"clear scheduler statistics" },
+	{ "task stats",			cmd_task_stats,			"task timing, cpu load, est. mA" },
+	{ "zero show",			cmd_zero_show,			"shunt offset (mA) per temperature" },
+};
+
+#define CMD_COUNT	(sizeof(command_table) / sizeof(command_table[0]))
+
+/*
+ * Processes one received command line, if there is one
+ *	- Splits the line into lower case words
+ *	- Tries the first two words as the command name, then the first word
+ */
+void command_process( void )
+{
+	char *line;
+	char *argv[CMD_MAX_ARGS];
+	char name[CMD_NAME_SIZE];
+	const command_entry *cmd;
+	int argc;
+
+	line = BPS2PC_getline();
+	if( line == 0 ) return;
+
+	// Tokenize in place
+	argc = 0;
+	while(( *line != '\0' ) && ( argc < CMD_MAX_ARGS )){
+		while( *line == ' ' ) line++;
+		if( *line == '\0' ) break;
+		argv[argc++] = line;
+		while(( *line != ' ' ) && ( *line != '\0' )){
+			*line = tolower( *line );
+			line++;
+		}
+		if( *line == ' ' ) *line++ = '\0';
+	}
+	if( argc == 0 ) return;
+
+	cmd = 0;
+	if(( argc >= 2 ) && ( strlen( argv[0] ) + strlen( argv[1] ) + 2 <= CMD_NAME_SIZE )){
+		strcpy( name, argv[0] );
+		strcat( name, " " );
+		strcat( name, argv[1] );
+		cmd = command_find( name );
+		if( cmd != 0 ) cmd->handler( argc - 2, &argv[2] );
+	}
+	if( cmd == 0 ){
+		cmd = command_find( argv[0] );
+		if( cmd != 0 ) cmd->handler( argc - 1, &argv[1] );
+		else BPS2PC_puts( "Unknown command, type help" );
+	}
+}
+
+/*
+ * Binary search of command_table
+ */
+static const command_entry *command_find( const char *name )
+{
+	int lo, hi, mid, cmp;
+
+	lo = 0;
+	hi = CMD_COUNT - 1;
+	while( lo <= hi ){
+		mid = ( lo + hi ) >> 1;
+		cmp = strcmp( name, command_table[mid].name );
+		if( cmp == 0 ) return( &command_table[mid] );
+		if( cmp < 0 ) hi = mid - 1;
+		else lo = mid + 1;
+	}
+	return( 0 );
+}
+
+/**************************************************************************************************
+ * COMMAND HANDLERS
+ *	- Long outputs are produced by the main loop from the status flags
+ *************************************************************************************************/
+
+static void cmd_battery_current( int argc, char **argv )
+{
+	extern char batt_current_status;
+	batt_current_status = 1;
+}
+
+static void cmd_battery_state( int argc, char **argv )
+{
+	extern char batt_state_status;
+	batt_state_status = 1;
+}
+
+static void cmd_battery_temps( int argc, char **argv )
+{
+	extern char batt_temp_status;
+	batt_temp_status = 1;
+}
+
+static void cmd_battery_volts( int argc, char **argv )
+{
+	extern char batt_volt_status;
+	batt_volt_status = 1;
+}
+
+static void cmd_cal_save( int argc, char **argv )
+{
+	LTC_cal_save();
+	BPS2PC_puts( "Calibration saved" );
+}
+
+/*
+ * Sets one pack cell (0..34): gain error in ppm, offset in mV (0 0 clears it)
+ */
+static void cmd_cal_set( int argc, char **argv )
+{
+	int cell, ppm, mv;
+	unsigned char ltc, ch;
+	long gain;
+
+	if( argc < 3 ){
+		BPS2PC_puts( "cal set cell ppm mv" );
+		return;
+	}
+	cell = atoi( argv[0] );
+	ppm = atoi( argv[1] );
+	mv = atoi( argv[2] );
+	gain = ( (long) ppm * 4096L ) / 125000L;				// ppm to Q15
+	if(( cell < 0 ) || ( cell > 34 ) || ( gain > LTC_CAL_GAIN_MAX ) || ( gain < -LTC_CAL_GAIN_MAX )
+		|| ( mv > 150 ) || ( mv < -150 )){
+		BPS2PC_puts( "Cell 0..34, ppm +/-30000, mv +/-150" );
+		return;
+	}
+	cmd_cal_channel( cell, &ltc, &ch );
+	ltc_cal.gain[ltc][ch] = (int) gain;
+	ltc_cal.offset[ltc][ch] = (signed char)(( mv * 2 + (( mv < 0 ) ? -1 : 1 )) / 3 );	// mV to codes, rounded
+	BPS2PC_puts( "Set, cal save to keep it" );
+}
+
+/*
+ * One line per cell with a non-zero entry: cell, gain (Q15), offset (codes)
+ */
+static void cmd_cal_show( int argc, char **argv )
+{
+	unsigned char n, ltc, ch;
+
+	BPS2PC_puts( ltc_cal_valid ? "Table from flash" : "No table in flash" );
+	for( n = 0; n < 35; n++ ){
+		cmd_cal_channel( n, &ltc, &ch );
+		if(( ltc_cal.gain[ltc][ch] == 0 ) && ( ltc_cal.offset[ltc][ch] == 0 )) continue;
+		BPS2PC_put_str( "cell " );
+		BPS2PC_put_udec( n );
+		BPS2PC_put_str( " gain " );
+		BPS2PC_put_dec( ltc_cal.gain[ltc][ch] );
+		BPS2PC_put_str( " offset " );
+		BPS2PC_put_dec( ltc_cal.offset[ltc][ch] );
+		BPS2PC_puts( "" );
+	}
+}
+
+/*
+ * LTC (0..2) and channel of pack cell 0..34
+ */
+static void cmd_cal_channel( unsigned char cell, unsigned char *ltc, unsigned char *ch )
+{
+	if( cell < 11 ){
+		*ltc = 0;
+		*ch = cell;
+	}
+	else if( cell < 23 ){
+		*ltc = 1;
+		*ch = cell - 11;
+	}
+	else{
+		*ltc = 2;
+		*ch = cell - 23;
+	}
+}
+
+static void cmd_stream_off( int argc, char **argv )
+{
+	stream_enable( 0 );
+	BPS2PC_puts( "Stream off" );
+}
+
+static void cmd_stream_on( int argc, char **argv )
+{
+	int n = 1;
+
+	if( argc > 0 ) n = atoi( argv[0] );
+	if(( n < 1 ) || ( n > 255 )){
+		BPS2PC_puts( "Divider 1..255" );
+		return;
+	}
+	BPS2PC_puts( "Stream on" );
+	stream_enable( (unsigned char) n );
+}
+
+/*
+ * One line per probe: id, name, count, min/avg/max us
+ */
+static void cmd_probe_stats( int argc, char **argv )
+{
+	const probe_stats *p;
+	unsigned char n;
+
+	for( n = 0; n < PROBE_COUNT; n++ ){
+		p = &probe[n];
+		if( *probe_name( n ) == '\0' ) continue;
+		BPS2PC_put_udec( n );
+		BPS2PC_put_str( " " );
+		BPS2PC_put_str( probe_name( n ));
+		BPS2PC_put_str( " n " );
+		BPS2PC_put_udec( p->count );
+		if( p->count != 0 ){
+			BPS2PC_put_str( " min " );
+			BPS2PC_put_udec( p->min );
+			BPS2PC_put_str( " avg " );
+			BPS2PC_put_udec( (unsigned long)( p->sum / p->count ));
+			BPS2PC_put_str( " max " );
+			BPS2PC_put_udec( p->max );
+		}
+		BPS2PC_puts( "" );
+	}
+}
+
+/*
+ * Non-empty histogram bins of one probe, bin n is 2^n..2^(n+1)-1 us
+ */
+static void cmd_probe_hist( int argc, char **argv )
+{
+	const probe_stats *p;
+	unsigned char n;
+	int id;
+
+	id = ( argc > 0 ) ? atoi( argv[0] ) : -1;
+	if(( id < 0 ) || ( id >= PROBE_COUNT ) || ( *probe_name( id ) == '\0' )){
+		BPS2PC_puts( "Probe id from probe stats" );
+		return;
+	}
+	p = &probe[id];
+	BPS2PC_puts( probe_name( id ));
+	for( n = 0; n < PROBE_BINS; n++ ){
+		if( p->hist[n] == 0 ) continue;
+		BPS2PC_put_str(( n == PROBE_BINS - 1 ) ? ">= " : "< " );
+		BPS2PC_put_udec(( n == PROBE_BINS - 1 ) ? ( 1UL << n ) : ( 2UL << n ));
+		BPS2PC_put_str( " us " );
+		BPS2PC_put_udec( p->hist[n] );
+		BPS2PC_puts( "" );
+	}
+}
+
+static void cmd_fault_clear( int argc, char **argv )
+{
+	trip_clear();
+	i2t_clear();
+	BPS2PC_puts( "Trip record cleared" );
+}
+
+/*
+ * First (latched) and last trip, then the trip count and worst sample to open time
+ */
+static void cmd_fault_show( int argc, char **argv )
+{
+	unsigned char n;
+
+	BPS2PC_put_str( "filtered" );
+	for( n = 0; n < TRIP_CLASSES; n++ ){
+		BPS2PC_put_str( " " );
+		BPS2PC_put_udec( trip_filt[n].marginal );
+	}
+	BPS2PC_puts( "" );
+	if( trip.count == 0 ){
+		BPS2PC_puts( "No trips" );
+		return;
+	}
+	cmd_trip_event( "first", &trip.first );
+	cmd_trip_event( "last", &trip.last );
+	BPS2PC_put_str( "trips " );
+	BPS2PC_put_udec( trip.count );
+	BPS2PC_put_str( " worst 0x" );
+	BPS2PC_put_hex( trip.worst_err, 2 );
+	BPS2PC_put_str( " " );
+	BPS2PC_put_udec( trip.worst );
+	BPS2PC_puts( " us" );
+}
+
+/*
+ * Fault code, tick, sample to detect and detect to contactor command (us)
+ */
+static void cmd_trip_event( const char *label, const trip_event *e )
+{
+	BPS2PC_put_str( label );
+	BPS2PC_put_str( " 0x" );
+	BPS2PC_put_hex( e->err, 2 );
+	BPS2PC_put_str( " tick " );
+	BPS2PC_put_udec( e->tick );
+	BPS2PC_put_str( " detect " );
+	BPS2PC_put_udec( e->t_detect - e->t_sample );
+	BPS2PC_put_str( " open " );
+	BPS2PC_put_udec( e->t_open - e->t_detect );
+	BPS2PC_put_str( " total " );
+	BPS2PC_put_udec( e->t_open - e->t_sample );
+	BPS2PC_puts( " us" );
+}
+
+/*
+ * Shunt current, then one line per I2t element
+ */
+static void cmd_i2t_show( int argc, char **argv )
+{
+	unsigned char n;
+
+	BPS2PC_put_str( "current " );
+	BPS2PC_put_fixed( i2t_da, 1 );
+	BPS2PC_puts( " A" );
+	for( n = 0; n < I2T_ELEMENTS; n++ ){
+		BPS2PC_put_str( i2t_elements[n].name );
+		BPS2PC_put_str( " heat " );
+		BPS2PC_put_fixed( i2t_level( n ), 1 );
+		BPS2PC_put_str( "% peak " );
+		BPS2PC_put_fixed( i2t[n].peak, 1 );
+		BPS2PC_put_str( "% trips " );
+		BPS2PC_put_udec( i2t[n].trips );
+		BPS2PC_puts( "" );
+	}
+}
+
+/*
+ * Current mode and time in it, then every mode entered since init with its entry time
+ */
+static void cmd_mode_show( int argc, char **argv )
+{
+	extern volatile unsigned char bpsMODE;
+	extern unsigned long init_us, boot_us;
+	extern unsigned char adc_cal_late, ltc_init_err;
+	unsigned char n;
+
+	BPS2PC_put_str( mode_states[bpsMODE].name );
+	BPS2PC_put_str( " for " );
+	BPS2PC_put_udec( mode_time() );
+	BPS2PC_put_str( " ms, changes " );
+	BPS2PC_put_udec( mode_changes );
+	BPS2PC_puts( "" );
+	BPS2PC_put_str( "init " );
+	BPS2PC_put_udec( init_us );
+	BPS2PC_put_str( " us, reset to selfcheck " );
+	BPS2PC_put_udec( boot_us );
+	BPS2PC_put_str( " us, adc late 0x" );
+	BPS2PC_put_hex( adc_cal_late, 2 );
+	BPS2PC_put_str( " ltc err 0x" );
+	BPS2PC_put_hex( ltc_init_err, 2 );
+	BPS2PC_puts( "" );
+	for( n = 0; n < mode_nstates; n++ ){
+		if(( mode_visited & ( 1 << n )) == 0 ) continue;
+		BPS2PC_put_str( mode_states[n].name );
+		BPS2PC_put_str( " +" );
+		BPS2PC_put_udec( MODE_TICKS_TO_MS( (unsigned int)( mode_entered[n] - mode_entered[0] )));
+		BPS2PC_puts( " ms" );
+	}
+}
+
+/*
+ * Last SIG1 and LTC sum comparison, largest difference, counts
+ */
+static void cmd_packv_show( int argc, char **argv )
+{
+	BPS2PC_put_str( "sig1 " );
+	BPS2PC_put_fixed( packv.sig1_mv, 3 );
+	BPS2PC_put_str( " sum " );
+	BPS2PC_put_fixed( packv.sum_mv, 3 );
+	BPS2PC_put_str( " diff " );
+	BPS2PC_put_fixed( packv.diff_mv, 3 );
+	BPS2PC_put_str( " max " );
+	BPS2PC_put_fixed( packv.diff_max, 3 );
+	BPS2PC_put_str(( packv.status & PACKV_SKIPPED ) ? ", skipped" : "" );
+	BPS2PC_puts(( packv.status & PACKV_STALE ) ? ", stale" : "" );
+	BPS2PC_put_str( "compared " );
+	BPS2PC_put_udec( packv.compare_cnt );
+	BPS2PC_put_str( " skipped " );
+	BPS2PC_put_udec( packv.skip_cnt );
+	BPS2PC_put_str( " mismatches " );
+	BPS2PC_put_udec( packv.mismatch_cnt );
+	BPS2PC_put_str( " stale " );
+	BPS2PC_put_udec( packv.stale_cnt );
+	BPS2PC_puts( "" );
+}
+
+/*
+ * State, fault, first and latest SIG1 - SIG2, halving time, predicted and actual completion
+ */
+static void cmd_precharge_show( int argc, char **argv )
+{
+	static const char * const names[] = { "idle", "charging", "charged", "mc ready", "fault" };
+
+	BPS2PC_put_str( names[pchg.state] );
+	BPS2PC_put_str( " fault 0x" );
+	BPS2PC_put_hex( pchg.fault, 2 );
+	BPS2PC_put_str( " d0 0x" );
+	BPS2PC_put_hex( pchg.d0, 6 );
+	BPS2PC_put_str( " diff 0x" );
+	BPS2PC_put_hex( pchg.diff, 6 );
+	BPS2PC_puts( "" );
+	BPS2PC_put_str( "halvings " );
+	BPS2PC_put_udec( pchg.halvings );
+	BPS2PC_put_str( " t_half " );
+	BPS2PC_put_udec( MODE_TICKS_TO_MS( pchg.t_half ));
+	BPS2PC_put_str( " pred " );
+	BPS2PC_put_udec( MODE_TICKS_TO_MS( pchg.t_pred ));
+	BPS2PC_put_str( " done " );
+	BPS2PC_put_udec( MODE_TICKS_TO_MS( pchg.t_done ));
+	BPS2PC_put_str( " elapsed " );
+	BPS2PC_put_udec( MODE_TICKS_TO_MS( pchg.elapsed ));
+	BPS2PC_puts( " ms" );
+}
+
+static void cmd_probe_reset( int argc, char **argv )
+{
+	probe_clear();
+	BPS2PC_puts( "Probes cleared" );
+}
+
+/*
+ * One line per contactor, in RLY_xxx bit order
+ */
+static void cmd_relay_state( int argc, char **argv )
+{
+	static const char * const names[RLY_COUNT] = { "batt", "array", "mcpc", "mc", "ext mcpc" };
+	unsigned char n, bit;
+
+	for( n = 0, bit = 0x01; n < RLY_COUNT; n++, bit <<= 1 ){
+		BPS2PC_put_str( names[n] );
+		if( relay.cmd & bit ) BPS2PC_puts(( relay.closed & bit ) ? " closed" : " closing" );
+		else BPS2PC_puts(( relay.moving & bit ) ? " opening" : " open" );
+	}
+	BPS2PC_put_str( "readback err " );
+	BPS2PC_put_udec( relay.readback_err );
+	BPS2PC_put_str( " open seq " );
+	BPS2PC_put_udec( relay.open_all_cnt );
+	BPS2PC_puts( relay_busy() ? " running" : "" );
+}
+
+/*
+ * SOC and charge left, last current, rest time, flash records and recalibrations
+ */
+static void cmd_soc_show( int argc, char **argv )
+{
+	if(( soc.status & SOC_VALID ) == 0x00 ){
+		BPS2PC_puts( "SOC not known yet" );
+		return;
+	}
+	BPS2PC_put_str( "soc " );
+	BPS2PC_put_fixed( soc_permille(), 1 );
+	BPS2PC_put_str( "% " );
+	BPS2PC_put_fixed( soc.q / SOC_Q_PER_MAH, 3 );
+	BPS2PC_put_str( " Ah i " );
+	BPS2PC_put_dec( soc.ma );
+	BPS2PC_put_str( " mA rest " );
+	BPS2PC_put_udec( soc.rest_us / 1000000UL );
+	BPS2PC_puts(( soc.status & SOC_FROM_FLASH ) ? " s, from flash" : " s" );
+	BPS2PC_put_str( "records " );
+	BPS2PC_put_udec( soc.saves );
+	BPS2PC_put_str( " slot " );
+	BPS2PC_put_udec( soc.slot );
+	BPS2PC_put_str( " recal " );
+	BPS2PC_put_udec( soc.recals );
+	BPS2PC_puts( "" );
+}
+
+static void cmd_task_reset( int argc, char **argv )
+{
+	sched_clear();
+	BPS2PC_puts( "Task statistics cleared" );
+}
+
+/*
+ * One line per task: runs, deadline misses, release to start (min-max) and longest run
+ */
+static void cmd_task_stats( int argc, char **argv )
+{
+	const sched_task *t;
+	unsigned char n;
+
+	for( n = 0; n < sched_count; n++ ){
+		t = &sched_table[n];
+		BPS2PC_put_str( t->name );
+		BPS2PC_put_str( " runs " );
+		BPS2PC_put_udec( t->runs );
+		BPS2PC_put_str( " miss " );
+		BPS2PC_put_udec( t->misses );
+		BPS2PC_put_str( " late " );
+		BPS2PC_put_udec( ( t->runs == 0 ) ? 0 : SCHED_COUNTS_TO_US( t->late_min ));
+		BPS2PC_put_str( "-" );
+		BPS2PC_put_udec( SCHED_COUNTS_TO_US( t->late_max ));
+		BPS2PC_put_str( " run " );
+		BPS2PC_put_udec( SCHED_COUNTS_TO_US( t->exec_max ));
+		BPS2PC_puts( " us" );
+	}
+	BPS2PC_put_str( "cpu active " );
+	BPS2PC_put_fixed( sched_duty, 1 );
+	BPS2PC_put_str( "% max " );
+	BPS2PC_put_fixed( sched_duty_max, 1 );
+	BPS2PC_put_str( "% est " );
+	BPS2PC_put_fixed( CPU_I_EST_UA( sched_duty ), 3 );
+	BPS2PC_puts( " mA" );
+}
+
+/*
+ * Applied shunt offset, window counts, then each measured temperature bin
+ */
+static void cmd_zero_show( int argc, char **argv )
+{
+	unsigned char n;
+
+	BPS2PC_put_str( "offset " );
+	BPS2PC_put_dec( SOC_CODE_TO_MA( zero.offset ));
+	BPS2PC_put_str( " mA at " );
+	BPS2PC_put_fixed( zero.t_cc, 2 );
+	BPS2PC_put_str( " C, windows " );
+	BPS2PC_put_udec( zero.windows );
+	BPS2PC_put_str( " rejects " );
+	BPS2PC_put_udec( zero.rejects );
+	BPS2PC_put_str( " saves " );
+	BPS2PC_put_udec( zero.saves );
+	BPS2PC_put_str(( zero.status & ZERO_FROM_FLASH ) ? ", from flash" : "" );
+	BPS2PC_puts(( zero.status & ZERO_FLASH_FAIL ) ? ", flash write failed" : "" );
+	for( n = 0; n < ZERO_BINS; n++ ){
+		if(( zero.table.valid & ( 1 << n )) == 0x0000 ) continue;
+		BPS2PC_put_udec( n * ( ZERO_BIN_CC / 100 ));
+		BPS2PC_put_str( "-" );
+		BPS2PC_put_udec(( n + 1 ) * ( ZERO_BIN_CC / 100 ));
+		BPS2PC_put_str( " C " );
+		BPS2PC_put_dec( SOC_CODE_TO_MA( zero.table.offset[n] ));
+		BPS2PC_puts( " mA" );
+	}
+}
+
+static void cmd_help( int argc, char **argv )
+{
+	unsigned int n;
+	char line[64];
+
+	for( n = 0; n < CMD_COUNT; n++ ){
+		strcpy( line, command_table[n].name );
+		strcat( line, " - " );
+		strcat( line, command_table[n].help );
+		BPS2PC_puts( line );
+	}
+}
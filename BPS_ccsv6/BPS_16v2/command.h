@@ -0,0 +1,28 @@
+/*
+ * RS232 command processor
+ *
+ * Command lines are assembled from the RX ring by BPS2PC_getline, split into
+ * words and looked up in a sorted table. A command name is one or two words
+ * ("help", "battery temps"); any further words are passed to the handler.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef COMMAND_H_
+#define COMMAND_H_
+
+// Public function prototypes
+extern void		command_process( void );
+
+#define CMD_MAX_ARGS		6			// Words per line, including the command name
+#define CMD_NAME_SIZE		24			// Longest two word command name + 1
+
+typedef struct _command_entry
+{
+  const char		*name;				// Lower case, words separated by one space
+  void				(*handler)( int argc, char **argv );	// Words after the name
+  const char		*help;				// One line description, 36 characters max
+} command_entry;
+
+#endif /*COMMAND_H_*/
@@ -0,0 +1,60 @@
+/*
+ * Info flash programming
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - Runs from main flash, so the CPU is held for each erase (~25 ms) and
+ *   word write (~85 us), with interrupts off for the whole operation
+ * - Erase clears the segment of dst, writes can only clear bits, so a word
+ *   is only rewritten after an erase
+ * - Each write is read back, a worn or failing segment shows as FALSE
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "flash.h"
+
+/*
+ * Programs words from src to dst, erasing the segment of dst first if erase
+ *	- TRUE when dst reads back as src
+ */
+unsigned char flash_write( void *dst, const void *src, unsigned int words, unsigned char erase )
+{
+	volatile unsigned int *d = (volatile unsigned int *) dst;
+	const unsigned int *s = (const unsigned int *) src;
+	unsigned int n = words;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	while( FCTL3 & BUSY );
+	FCTL3 = FWKEY;									// unlock
+	if( erase ){
+		FCTL1 = FWKEY | ERASE;
+		*d = 0;										// dummy write starts the segment erase
+		while( FCTL3 & BUSY );
+	}
+	FCTL1 = FWKEY | WRT;
+	while( words-- != 0 ) *d++ = *s++;
+	FCTL1 = FWKEY;
+	FCTL3 = FWKEY | LOCK;
+	__bis_SR_register( sr & GIE );
+
+	d = (volatile unsigned int *) dst;
+	s = (const unsigned int *) src;
+	while( n-- != 0 ) if( *d++ != *s++ ) return( FALSE );
+	return( TRUE );
+}
+
+/*
+ * Check word of a table: ~sum of its first words words
+ */
+unsigned int flash_check( const void *src, unsigned int words )
+{
+	const unsigned int *w = (const unsigned int *) src;
+	unsigned int sum = 0;
+
+	while( words-- != 0 ) sum += *w++;
+	return( ~sum );
+}
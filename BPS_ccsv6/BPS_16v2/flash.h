@@ -0,0 +1,27 @@
+/*
+ * Info flash programming
+ *
+ * The info segments B, C and D (128 bytes each) hold the data that has to
+ * survive a reset: the SOC records in D, the cell calibration table in C and
+ * the shunt zero offsets in B.
+ * Segment A (calibration data from TI) is never touched. The tables in B and
+ * C end in a flash_check word, ~sum of the words before it.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef FLASH_H_
+#define FLASH_H_
+
+// Public function prototypes
+extern unsigned char	flash_write( void *dst, const void *src, unsigned int words, unsigned char erase );
+extern unsigned int		flash_check( const void *src, unsigned int words );
+
+// Info segments
+#define FLASH_INFOD				0x1800
+#define FLASH_INFOC				0x1880
+#define FLASH_INFOB				0x1900
+#define FLASH_SEGMENT			128
+
+#endif /*FLASH_H_*/
@@ -0,0 +1,90 @@
+/*
+ * I2t overload model of the battery current path
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - Runs in the measure task on the raw shunt code, no float: the code is
+ *   scaled to 0.1 A with one multiply, squared, and each element's state
+ *   moves towards it by a shift
+ * - The ratings and time constants are estimates, set them from the cell,
+ *   fuse and contactor data sheets. Ratings sit below MAX_CURRENT_DISCHARGE
+ *   so that bursts between the two are allowed for a time
+ * - The state is only cleared by reset, a trip does not cool the parts
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "i2t.h"
+#include "trip.h"
+
+// Public variables
+const i2t_element i2t_elements[I2T_ELEMENTS] =
+{
+	// name			rating	heat	cool	err
+	{ "cells",		600,	11,		12,		0x31 },		// 60 A continuous, tau 123 s / 246 s
+	{ "fuse",		750,	8,		8,		0x32 },		// 75 A, tau 15 s
+	{ "contactors",	700,	10,		11,		0x33 },		// 70 A, tau 61 s / 123 s
+};
+
+i2t_state				i2t[I2T_ELEMENTS];
+unsigned int			i2t_da = 0;
+
+/*
+ * One shunt sample: code is diff_shunt - diff_ref, either direction heats
+ *	- Trips (bps_trip) with the element's code while its state is over the limit
+ */
+void i2t_sample( long code, unsigned long t_sample )
+{
+	const i2t_element *e;
+	i2t_state *s;
+	unsigned char n;
+	unsigned long mag, target;
+	unsigned int level;
+	unsigned char over;
+
+	mag = ( code < 0 ) ? -code : code;
+	mag = (( mag >> 8 ) * I2T_FS_DA ) >> 16;
+	if( mag > I2T_DA_MAX ) mag = I2T_DA_MAX;
+	i2t_da = (unsigned int) mag;
+	target = ( mag * mag ) << I2T_FRAC;
+
+	for( n = 0, e = i2t_elements, s = i2t; n < I2T_ELEMENTS; n++, e++, s++ ){
+		if( s->limit == 0 ) s->limit = ( (unsigned long) e->rating_da * e->rating_da ) << I2T_FRAC;
+		over = ( s->heat >= s->limit );
+		if( target > s->heat ) s->heat += ( target - s->heat ) >> e->heat_shift;
+		else s->heat -= ( s->heat - target ) >> e->cool_shift;
+
+		level = i2t_level( n );
+		if( level > s->peak ) s->peak = level;
+		if( s->heat >= s->limit ){
+			if( !over && ( s->trips < 0xFFFF )) s->trips++;
+			bps_trip( e->err, t_sample );
+		}
+	}
+}
+
+/*
+ * Heat as 0.1 % of the trip limit
+ */
+unsigned int i2t_level( unsigned char n )
+{
+	unsigned long level;
+
+	if(( n >= I2T_ELEMENTS ) || ( i2t[n].limit < 1000 )) return( 0 );
+	level = i2t[n].heat / ( i2t[n].limit / 1000 );
+	return(( level > 0xFFFF ) ? 0xFFFF : (unsigned int) level );
+}
+
+/*
+ * Clears the peaks and trip counts, not the thermal state
+ */
+void i2t_clear( void )
+{
+	unsigned char n;
+
+	for( n = 0; n < I2T_ELEMENTS; n++ ){
+		i2t[n].peak = 0;
+		i2t[n].trips = 0;
+	}
+}
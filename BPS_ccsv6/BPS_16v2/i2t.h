@@ -0,0 +1,65 @@
+/*
+ * I2t overload model of the battery current path
+ *
+ * Each element (cells, main fuse, contactors) has a thermal state that
+ * follows the square of the shunt current with a first order lag:
+ *
+ *		heat += ( I^2 - heat ) / tau
+ *
+ * so the state settles at I^2 for a steady current. It trips when the state
+ * passes the square of the continuous rating, which a steady current at
+ * the rating never does. A short burst above the rating only raises the
+ * state part of the way, a sustained overload of I trips after about
+ * tau * ln( I^2 / ( I^2 - Irated^2 )). Heating and cooling have separate time
+ * constants, both a power of two of the sample period, so the update is
+ * integer shifts and one multiply. The instantaneous MAX_CURRENT_DISCHARGE /
+ * CHARGE limits stay in force above this.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef I2T_H_
+#define I2T_H_
+
+// Public function prototypes
+extern void				i2t_sample( long code, unsigned long t_sample );
+extern void				i2t_clear( void );
+extern unsigned int		i2t_level( unsigned char n );
+
+// Shunt ADC code (diff_shunt - diff_ref) to 0.1 A: ( |code| >> 8 ) * I2T_FS_DA >> 16
+#define I2T_FS_DA				1338		// CURRENT_I_SCALE in 0.1 A (133.75 A full scale)
+#define I2T_DA_MAX				2000		// Clamp, keeps the scaled I^2 under 2^31
+#define I2T_FRAC				8			// Fraction bits of the heat state
+
+// Sample period: one shunt reading per measure task run
+#define I2T_DT_MS				(LTC_STATUS_COUNT / 2 * 10)
+
+// Elements
+#define I2T_CELLS				0
+#define I2T_FUSE				1
+#define I2T_CONTACTORS			2
+#define I2T_ELEMENTS			3
+
+typedef struct _i2t_element
+{
+  const char		*name;
+  unsigned int		rating_da;			// Continuous current (0.1 A)
+  unsigned char		heat_shift;			// tau heating = I2T_DT_MS << heat_shift
+  unsigned char		cool_shift;			// tau cooling = I2T_DT_MS << cool_shift
+  unsigned char		err;				// batt_ERR when tripped
+} i2t_element;
+
+typedef struct _i2t_state
+{
+  unsigned long		heat;				// (0.1 A)^2 << I2T_FRAC
+  unsigned long		limit;				// rating_da^2 << I2T_FRAC
+  unsigned int		peak;				// Highest heat since i2t_clear (0.1 % of limit)
+  unsigned int		trips;				// Times the state crossed the limit
+} i2t_state;
+
+extern const i2t_element	i2t_elements[I2T_ELEMENTS];
+extern i2t_state			i2t[I2T_ELEMENTS];
+extern unsigned int			i2t_da;		// Last sample (0.1 A, magnitude)
+
+#endif /*I2T_H_*/
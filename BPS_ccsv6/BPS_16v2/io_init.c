@@ -35,12 +35,12 @@ void io_init( void )
 	P2OUT = 0x00;			// Pull pins low
  	P2DIR = P2_UNUSED;		//set to output
     /*Interrupts Enable */
-    //    P2SEL = CAN_INTn; //Interrupts
-	//    P2IE  = CAN_INTn; // Enable Interrupts 
+    P2IES = CAN_INTn;			//CAN_INTn is active low, interrupt on high to low
 	//    P2SEL |= ADC1_RDY | ADC2_RDY | ADC3_RDY | ADC4_RDY ADC1_RDY | ADC5_RDY | ADC6_RDY | ADC7_RDY;
 	//    P2IES |= ADC1_RDY | ADC2_RDY | ADC3_RDY | ADC4_RDY ADC1_RDY | ADC5_RDY | ADC6_RDY | ADC7_RDY; 
 	//	  P2IE  |= ADC1_RDY | ADC2_RDY | ADC3_RDY | ADC4_RDY ADC1_RDY | ADC5_RDY | ADC6_RDY | ADC7_RDY;
     P2IFG = 0x00;       				//Clears all interrupt flags on Port 2
+    P2IE  = CAN_INTn;					//Enable CAN controller interrupt
     delay();
 
     /******************************PORT 3**************************************/  
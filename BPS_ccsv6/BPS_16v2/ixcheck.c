@@ -0,0 +1,97 @@
+/*
+ * Redundant battery current cross check
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - BPS shunt samples are kept with their tick stamps in a short history
+ * - Each MC_BUS frame (5 Hz) is matched to the BPS sample closest in time,
+ *   using the latest AC_ISH array current
+ * - The residual is IIR filtered so that ripple and the frame skew average out,
+ *   leaving the offset/gain drift of the shunt path
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "ixcheck.h"
+
+// Public variables
+ix_state				ix;
+
+// Private variables
+static long				hist_ma[IX_HIST_SIZE];		// BPS shunt current history (mA)
+static unsigned int		hist_tick[IX_HIST_SIZE];	// Tick of each history sample
+static unsigned char	hist_head = 0;
+static unsigned char	hist_count = 0;
+
+/*
+ * Stores a BPS shunt current sample
+ *	- Call once per current measurement, with the tick it was taken
+ */
+void ix_bps_sample( long current_ma, unsigned int tick )
+{
+	hist_ma[hist_head] = current_ma;
+	hist_tick[hist_head] = tick;
+	hist_head++;
+	if( hist_head >= IX_HIST_SIZE ) hist_head = 0;
+	if( hist_count < IX_HIST_SIZE ) hist_count++;
+}
+
+/*
+ * Stores the array controller current
+ */
+void ix_ac_frame( float array_current, unsigned int tick )
+{
+	ix.i_ac = (long)( array_current * IX_AC_SCALE );
+	ix.ac_tick = tick;
+}
+
+/*
+ * Runs one comparison from a motor controller bus current frame
+ *	- Finds the BPS sample nearest to the frame tick
+ *	- Skips the comparison (IX_STALE) if no sample is close enough or the
+ *	  array current is too old
+ */
+void ix_mc_frame( float bus_current, unsigned int tick )
+{
+	unsigned char n, idx;
+	unsigned int skew, best;
+
+	ix.i_mc = (long)( bus_current * IX_MC_SCALE );
+
+	// Closest BPS sample, either side of the frame
+	best = 0xFFFF;
+	idx = hist_head;
+	for( n = 0; n < hist_count; n++ ){
+		idx = ( idx == 0 ) ? ( IX_HIST_SIZE - 1 ) : ( idx - 1 );
+		skew = tick - hist_tick[idx];
+		if( skew > 0x7FFF ) skew = -skew;
+		if( skew < best ){
+			best = skew;
+			ix.i_bps = hist_ma[idx];
+		}
+	}
+
+	if(( best > IX_ALIGN_MAX ) || (( tick - ix.ac_tick ) > IX_AC_MAX_AGE )){
+		ix.status |= IX_STALE;
+		return;
+	}
+	ix.status &= ~IX_STALE;
+
+	ix.residual = ix.i_bps - ( ix.i_mc - ix.i_ac + IX_AUX_LOAD );
+	if( ix.compare_cnt == 0 ) ix.filt = ix.residual;
+	else ix.filt += ( ix.residual - ix.filt ) >> IX_FILTER_SHIFT;
+	ix.compare_cnt++;
+
+	if(( ix.filt > IX_TOLERANCE ) || ( ix.filt < -IX_TOLERANCE )){
+		if( ix.persist < IX_PERSIST ) ix.persist++;
+		else if(( ix.status & IX_DRIFT ) == 0x00 ){
+			ix.status |= IX_DRIFT;
+			ix.drift_cnt++;
+		}
+	}
+	else{
+		ix.persist = 0;
+		ix.status &= ~IX_DRIFT;
+	}
+}
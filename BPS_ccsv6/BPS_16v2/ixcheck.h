@@ -0,0 +1,59 @@
+/*
+ * Redundant battery current cross check
+ *
+ * Compares the BPS shunt current against the current implied by the
+ * motor controller and array controller CAN frames:
+ *
+ *		I_bps  =  I_mc(bus)  -  I_array  (+ auxiliary loads)
+ *
+ * A slowly filtered residual outside tolerance points to shunt or ADC drift.
+ * The check only flags the condition, it never opens a contactor.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef IXCHECK_H_
+#define IXCHECK_H_
+
+// Public function prototypes
+extern void		ix_bps_sample( long current_ma, unsigned int tick );
+extern void		ix_mc_frame( float bus_current, unsigned int tick );
+extern void		ix_ac_frame( float array_current, unsigned int tick );
+
+// Scaling of the CAN currents to mA (positive = MC drawing from / array feeding the bus)
+#define IX_MC_SCALE			1000.0		// MC_BUS bus current is sent in A
+#define IX_AC_SCALE			1.0			// AC_ISH shunt current is sent in mA, like BP_ISH
+
+// Timing, in timer B ticks
+#define IX_HIST_SIZE		16			// BPS samples kept for alignment (~1 sec at the measure task rate)
+#define IX_ALIGN_MAX		6			// Max. skew between an MC frame and the matched BPS sample
+#define IX_AC_MAX_AGE		150			// AC_ISH older than this is stale (sent at 1 sec)
+
+// Residual filtering
+#define IX_AUX_LOAD			0			// Known auxiliary load on the pack side of the shunt (mA)
+#define IX_FILTER_SHIFT		3			// Residual IIR, new sample weight = 1/8
+#define IX_TOLERANCE		2000		// Filtered residual limit (mA)
+#define IX_PERSIST			25			// Consecutive comparisons out of tolerance (~5 sec)
+
+// Status bits (ix.status)
+#define IX_STALE			0x01		// No aligned MC/AC data for the last comparison
+#define IX_DRIFT			0x02		// Residual out of tolerance for IX_PERSIST comparisons
+
+typedef struct _ix_state
+{
+  long				i_bps;				// Aligned BPS shunt current (mA)
+  long				i_mc;				// Last MC bus current (mA)
+  long				i_ac;				// Last array current (mA)
+  long				residual;			// Last unfiltered residual (mA)
+  long				filt;				// Filtered residual (mA)
+  unsigned int		ac_tick;			// Tick the array current was received
+  unsigned int		compare_cnt;		// Comparisons made
+  unsigned int		drift_cnt;			// Transitions into IX_DRIFT
+  unsigned char		persist;			// Consecutive out of tolerance comparisons
+  unsigned char		status;
+} ix_state;
+
+extern ix_state		ix;
+
+#endif /*IXCHECK_H_*/
@@ -0,0 +1,155 @@
+/*
+ * Pack statistics and dynamic current limits
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - pack_stats_update after each complete LTC scan
+ * - pack_temp_update after each temperature scan
+ * - limits_update after each current measurement
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "limits.h"
+#include "rcell.h"
+
+// Public variables
+pack_stats				pack;
+
+// Private function prototypes
+static long				taper( long full, int x, int x_full, int x_zero );
+
+/*
+ * Finds the min/max cell voltage and the cell sum from the last LTC scan
+ */
+void pack_stats_update( void )
+{
+	extern unsigned int ltc1_cv[12], ltc2_cv[12], ltc3_cv[12];
+	unsigned char n;
+	int mv;
+	unsigned int code;
+
+	pack.vmax_mv = -32768;
+	pack.vmin_mv = 32767;
+	pack.vsum_mv = 0;
+	for( n = 0; n < PACK_CELLS; n++ ){
+		if( n < 11 ) code = ltc1_cv[n];
+		else if( n < 23 ) code = ltc2_cv[n - 11];
+		else code = ltc3_cv[n - 23];
+		mv = LTC_CODE_TO_MV( code );
+		pack.vsum_mv += mv;
+		if( mv > pack.vmax_mv ){
+			pack.vmax_mv = mv;
+			pack.vmax_cell = n;
+		}
+		if( mv < pack.vmin_mv ){
+			pack.vmin_mv = mv;
+			pack.vmin_cell = n;
+		}
+	}
+	pack.valid |= PACK_VALID_V;
+}
+
+/*
+ * Finds the hottest and coldest connected cell temperature sensors
+ *	- Raw ADC codes fall as temperature rises
+ */
+void pack_temp_update( void )
+{
+	extern volatile unsigned long temperature_adc[40];
+	unsigned char n;
+	unsigned long code, cmin, cmax;
+	int c8;
+
+	cmin = 0xFFFFFFFF;
+	cmax = 0;
+	pack.tcold_code = 0;
+	for( n = PACK_TEMP_FIRST; n <= PACK_TEMP_LAST; n++ ){
+		code = temperature_adc[n];
+		c8 = ( code >= 0x800000UL ) ? 0x7FFF : (int)( code >> 8 );
+		if( c8 > pack.tcold_code ) pack.tcold_code = c8;
+		if( code >= MIN_TEMP_NOSENSOR ) continue;		// Open or very cold, tripped elsewhere, only the cold derate sees it
+		if( code < cmin ){
+			cmin = code;
+			pack.tmax_idx = n;
+		}
+		if( code > cmax ) cmax = code;
+	}
+	if( cmax == 0 ) return;								// No connected sensors
+	pack.tmax_c = ADC_TO_CENTI_C( cmin );
+	pack.tmin_c = ADC_TO_CENTI_C( cmax );
+	pack.valid |= PACK_VALID_T;
+}
+
+/*
+ * Computes the discharge and charge current limits
+ *	- Voltage limit: current that would take the weakest (strongest) cell to
+ *	  LIM_V_DCL_MIN (LIM_V_CCL_MAX), from its resistance compensated open circuit
+ *	  voltage, with that cell's online resistance estimate (rcell)
+ *	- Temperature limit: linear derate between the full and zero points, the
+ *	  cold charge derate on raw thermistor codes
+ *	- Limits fall immediately but only rise by LIM_SLEW_UP per update
+ *	- Both limits are zero until voltages and temperatures have been measured
+ */
+void limits_update( long current_ma )
+{
+	long ocv, dv, dcl, ccl, lim, r;
+
+	pack.i_filt += ( current_ma - pack.i_filt ) >> LIM_I_FILTER_SHIFT;
+
+	if(( pack.valid & ( PACK_VALID_V | PACK_VALID_T )) != ( PACK_VALID_V | PACK_VALID_T )){
+		pack.dcl = 0;
+		pack.ccl = 0;
+		return;
+	}
+
+	// Discharge
+	dcl = LIM_DCL_MAX;
+	r = rcell.r_uohm[pack.vmin_cell];
+	ocv = pack.vmin_mv + (( pack.i_filt / 100 ) * r ) / 10000L;		// 0.1 A * uOhm, mA * RCELL_R_MAX would overflow
+	dv = ocv - LIM_V_DCL_MIN;
+	if( dv < 0 ) dv = 0;
+	if( dv > 2000 ) dv = 2000;
+	lim = ( dv * 1000000L ) / r;
+	if( lim < dcl ) dcl = lim;
+	lim = taper( LIM_DCL_MAX, pack.tmax_c, LIM_T_DCL_FULL, LIM_T_DCL_ZERO );
+	if( lim < dcl ) dcl = lim;
+
+	// Charge
+	ccl = LIM_CCL_MAX;
+	r = rcell.r_uohm[pack.vmax_cell];
+	ocv = pack.vmax_mv + (( pack.i_filt / 100 ) * r ) / 10000L;
+	dv = LIM_V_CCL_MAX - ocv;
+	if( dv < 0 ) dv = 0;
+	if( dv > 2000 ) dv = 2000;
+	lim = ( dv * 1000000L ) / r;
+	if( lim < ccl ) ccl = lim;
+	lim = taper( LIM_CCL_MAX, pack.tmax_c, LIM_T_CCL_FULL, LIM_T_CCL_ZERO );
+	if( lim < ccl ) ccl = lim;
+	lim = taper( LIM_CCL_MAX, pack.tcold_code, LIM_CODE_CCL_COLD_FULL, LIM_CODE_CCL_COLD_ZERO );
+	if( lim < ccl ) ccl = lim;
+
+	// Fall immediately, recover slowly
+	if( dcl > pack.dcl + LIM_SLEW_UP ) dcl = pack.dcl + LIM_SLEW_UP;
+	if( ccl > pack.ccl + LIM_SLEW_UP ) ccl = pack.ccl + LIM_SLEW_UP;
+	pack.dcl = dcl;
+	pack.ccl = ccl;
+}
+
+/*
+ * Linear derate of full between x_full (full value) and x_zero (zero)
+ *	- Works in either direction (x_zero above or below x_full)
+ */
+static long taper( long full, int x, int x_full, int x_zero )
+{
+	if( x_full < x_zero ){
+		if( x <= x_full ) return( full );
+		if( x >= x_zero ) return( 0 );
+	}
+	else{
+		if( x >= x_full ) return( full );
+		if( x <= x_zero ) return( 0 );
+	}
+	return(( full * (long)( x_zero - x )) / (long)( x_zero - x_full ));
+}
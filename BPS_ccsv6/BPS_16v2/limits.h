@@ -0,0 +1,80 @@
+/*
+ * Pack statistics and dynamic current limits
+ *
+ * Discharge (DCL) and charge (CCL) current limits are computed from the
+ * min/max cell voltage, the cell temperatures and the recent current, so the
+ * motor controller and MPPTs can derate before the BPS has to open contactors.
+ * All arithmetic is integer (mV, mA, centi-degrees C).
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef LIMITS_H_
+#define LIMITS_H_
+
+// Public function prototypes
+extern void		pack_stats_update( void );
+extern void		pack_temp_update( void );
+extern void		limits_update( long current_ma );
+
+// LTC6803 cell code to mV: (code - 512) * 1.5 mV
+#define LTC_CODE_TO_MV(c)		((((int)(c)) - 512) * 3 / 2)
+
+// Thermistor ADC code to centi-degrees C, linear estimate 126.1575 - 311.329 * (code / 2^24)
+#define ADC_TO_CENTI_C(a)		(12616 - (int)((((unsigned long)(a) >> 8) * 31133UL) >> 16))
+
+#define PACK_CELLS				35			// LTC1 11 cells, LTC2 and LTC3 12 cells
+#define PACK_TEMP_FIRST			1			// temperature_adc[] cell sensor range
+#define PACK_TEMP_LAST			35
+
+// Current limits (mA), below the MAX_CURRENT_DISCHARGE/CHARGE trip points
+#define LIM_DCL_MAX				75000L
+#define LIM_CCL_MAX				18000L
+
+// Voltage taper: the limit current that would pull the weakest cell to these voltages
+#define LIM_R_CELL				3500L		// Nominal cell group resistance (uOhm), rcell prior
+#define LIM_V_DCL_MIN			2900		// mV, above the 2.640 V LTC undervoltage
+#define LIM_V_CCL_MAX			4100		// mV, below the 4.176 V LTC overvoltage
+
+// Temperature derate (centi-degrees C): full limit at the first value, zero at the second
+// (ADC_TO_CENTI_C reads MAX_TEMP_DISCHARGE as 62.4 C and MAX_TEMP_CHARGE as 45.0 C)
+#define LIM_T_DCL_FULL			5200
+#define LIM_T_DCL_ZERO			6000
+#define LIM_T_CCL_FULL			4000
+#define LIM_T_CCL_ZERO			4400
+
+// Cold charge derate on the raw code of the coldest cell sensor (code >> 8, rises as the cell cools).
+// ADC_TO_CENTI_C is fitted over 20 - 45 C and reads MIN_TEMP_NOSENSOR as only 6.7 C, so the cold
+// end can't be set in degrees. A sensor at or past MIN_TEMP_NOSENSOR may be open or colder still,
+// and stops charging instead of being skipped.
+#define LIM_CODE_CCL_COLD_FULL	0x5F84		// 10 C by ADC_TO_CENTI_C
+#define LIM_CODE_CCL_COLD_ZERO	((int)(MIN_TEMP_NOSENSOR >> 8))
+
+// Recent current filter and limit recovery
+#define LIM_I_FILTER_SHIFT		4			// IIR on the current samples, ~1 sec
+#define LIM_SLEW_UP				500L		// mA per update a limit may rise (~8 A/sec)
+
+typedef struct _pack_stats
+{
+  int				vmax_mv;			// Highest cell voltage
+  int				vmin_mv;			// Lowest cell voltage
+  unsigned char		vmax_cell;			// Cell number of vmax (0..34)
+  unsigned char		vmin_cell;			// Cell number of vmin (0..34)
+  long				vsum_mv;			// Pack voltage from the cell sum
+  int				tmax_c;				// Hottest cell sensor (centi-degrees C)
+  int				tmin_c;				// Coldest connected cell sensor (centi-degrees C)
+  int				tcold_code;			// Highest cell sensor code >> 8, open sensors included
+  unsigned char		tmax_idx;			// temperature_adc[] index of tmax
+  unsigned char		valid;				// Bit 0 voltages, bit 1 temperatures
+  long				i_filt;				// Recent current (mA, + = discharge)
+  long				dcl;				// Discharge current limit (mA)
+  long				ccl;				// Charge current limit (mA, positive)
+} pack_stats;
+
+#define PACK_VALID_V			0x01
+#define PACK_VALID_T			0x02
+
+extern pack_stats	pack;
+
+#endif /*LIMITS_H_*/
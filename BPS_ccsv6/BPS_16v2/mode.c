@@ -0,0 +1,125 @@
+/*
+ * Table driven BPS mode machine
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - The state and transition tables live with the mode code (BPSmain.c), the
+ *   index of a state in its table is its mode number
+ * - mode_step and mode_force are only called from the main loop (scheduler
+ *   tasks), never from an ISR, so the hooks may block
+ * - The dwell count adds up the ticks between mode_step calls and saturates,
+ *   a late step still sees the full time in the state
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "mode.h"
+
+// Public variables
+const mode_state		*mode_states = 0;
+unsigned char			mode_nstates = 0;
+unsigned int			mode_entered[MODE_STATES_MAX];
+unsigned int			mode_visited = 0;
+unsigned int			mode_changes = 0;
+
+// Private variables
+static volatile unsigned char	*mode_now = 0;		// Caller's mode variable
+static const mode_transition	*mode_table = 0;
+static unsigned char			mode_count = 0;
+static unsigned char			mode_initial = 0;
+static unsigned int				mode_dwell = 0;		// Ticks in the current state
+static unsigned int				mode_last = 0;		// tick_count at the last mode_step
+
+// Private function prototypes
+static void				mode_enter( unsigned char to );
+
+/*
+ * Sets up the tables and enters the initial state
+ */
+void mode_init( volatile unsigned char *current, const mode_state *states, unsigned char nstates,
+				const mode_transition *table, unsigned char count, unsigned char initial )
+{
+	mode_now = current;
+	mode_states = states;
+	mode_nstates = ( nstates > MODE_STATES_MAX ) ? MODE_STATES_MAX : nstates;
+	mode_table = table;
+	mode_count = count;
+	mode_initial = initial;
+	mode_enter( initial );
+	mode_changes = 0;
+}
+
+/*
+ * Runs the current state and takes the first transition that is due, every tick
+ */
+void mode_step( void )
+{
+	extern volatile unsigned int tick_count;
+	const mode_transition *t;
+	const mode_state *s;
+	unsigned char n, now;
+	unsigned int elapsed;
+
+	now = *mode_now;
+	elapsed = tick_count - mode_last;
+	mode_last += elapsed;
+	mode_dwell = (( mode_dwell + elapsed ) < mode_dwell ) ? 0xFFFF : ( mode_dwell + elapsed );
+
+	s = &mode_states[now];
+	if( s->during ) s->during();
+
+	for( n = 0, t = mode_table; n < mode_count; n++, t++ ){
+		if( t->from != now ) continue;
+		if( MODE_TICKS_TO_MS( mode_dwell ) < t->dwell_ms ) continue;
+		if(( t->guard != 0 ) && !t->guard()) continue;
+		if( t->to == now ){
+			if( t->action ) t->action();
+			continue;
+		}
+		if( s->exit ) s->exit();
+		if( t->action ) t->action();
+		mode_enter( t->to );
+		return;
+	}
+}
+
+/*
+ * Changes state outside the transition table, the exit and entry hooks still run
+ *	- No change if already in that state
+ */
+void mode_force( unsigned char to )
+{
+	const mode_state *s;
+
+	if(( to >= mode_nstates ) || ( to == *mode_now )) return;
+	s = &mode_states[*mode_now];
+	if( s->exit ) s->exit();
+	mode_enter( to );
+}
+
+/*
+ * Time in the current state (ms) as of the last mode_step
+ */
+unsigned long mode_time( void )
+{
+	return( MODE_TICKS_TO_MS( mode_dwell ));
+}
+
+static void mode_enter( unsigned char to )
+{
+	extern volatile unsigned int tick_count;
+	const mode_state *s;
+
+	*mode_now = to;
+	mode_dwell = 0;
+	mode_last = tick_count;
+	mode_changes++;
+	if( to == mode_initial ) mode_visited = 0;
+	mode_visited |= ( 1 << to );
+	mode_entered[to] = tick_count;
+
+	s = &mode_states[to];
+	if( s->led != 0 ) DR_LED_SHOW( s->led );
+	if( s->entry ) s->entry();
+}
@@ -0,0 +1,53 @@
+/*
+ * Table driven BPS mode machine
+ *
+ * Each state has an optional entry, during and exit hook and a DR LED code.
+ * Transitions are rows of (from, to, dwell, guard, action): mode_step runs the
+ * during hook of the current state, then takes the first row leaving it whose
+ * dwell time has passed and whose guard is true. mode_force changes state from
+ * outside the table (buttons, a protection trip). The tick of the last entry
+ * into every state is kept, so the startup sequence timing can be read back
+ * ("mode show" on RS232).
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef MODE_H_
+#define MODE_H_
+
+typedef struct _mode_state
+{
+  const char		*name;				// Short name for the RS232 listing
+  unsigned char		led;				// DR LED code shown on entry, 0 = the entry hook sets the LEDs
+  void				(*entry)( void );	// 0 = none
+  void				(*during)( void );	// Every mode_step while in the state, 0 = none
+  void				(*exit)( void );	// 0 = none
+} mode_state;
+
+typedef struct _mode_transition
+{
+  unsigned char		from;
+  unsigned char		to;					// to == from: action only, no exit/entry, dwell time kept
+  unsigned int		dwell_ms;			// Time in from before the guard is tried
+  unsigned char		(*guard)( void );	// 0 = always
+  void				(*action)( void );	// Runs between the exit and entry hooks, 0 = none
+} mode_transition;
+
+// Public function prototypes
+extern void				mode_init( volatile unsigned char *current, const mode_state *states, unsigned char nstates,
+									const mode_transition *table, unsigned char count, unsigned char initial );
+extern void				mode_step( void );
+extern void				mode_force( unsigned char to );
+extern unsigned long	mode_time( void );
+
+#define MODE_STATES_MAX			12
+#define MODE_TICKS_TO_MS(t)		((unsigned long)(t) * 1000UL / TICK_RATE)
+
+extern const mode_state	*mode_states;
+extern unsigned char	mode_nstates;
+extern unsigned int		mode_entered[MODE_STATES_MAX];	// tick_count at the last entry
+extern unsigned int		mode_visited;					// States entered since the initial state, bit per state
+extern unsigned int		mode_changes;					// State changes since mode_init
+
+#endif /*MODE_H_*/
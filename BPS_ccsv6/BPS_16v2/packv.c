@@ -0,0 +1,76 @@
+/*
+ * Redundant pack voltage cross check
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - Called by the LTC task at the end of each sweep, after pack_stats_update,
+ *   with a fresh SIG1 reading and shunt code
+ * - The cell sum uses the calibrated LTC codes (pack.vsum_mv), SIG1 is raw
+ * - Returns a trip level, the caller feeds the TRIP_PACKV fault class; a
+ *   skipped sweep is TRIP_OK, a long run of them only sets PACKV_STALE
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "packv.h"
+#include "limits.h"
+#include "rcell.h"
+#include "precharge.h"
+#include "trip.h"
+
+// Public variables
+packv_state				packv;
+
+// Private function prototypes
+static unsigned char	packv_skip( void );
+
+/*
+ * One comparison, sig1 is the SIG1 ADC code and code the shunt code at the same time
+ */
+unsigned char packv_check( unsigned long sig1, long code )
+{
+	unsigned char n;
+	int i_da, di;
+	long d;
+
+	if((( pack.valid & PACK_VALID_V ) == 0x00 ) || ( sig1 < PCHG_SIG1_MIN )) return( packv_skip() );
+	i_da = (int) RCELL_CODE_TO_DA( code );
+	for( n = 0; n < RCELL_LTCS; n++ ){
+		di = i_da - rcell.i_cv[n];
+		if(( di > PACKV_DI_MAX_DA ) || ( di < -PACKV_DI_MAX_DA )) return( packv_skip() );
+	}
+	packv.status &= ~( PACKV_SKIPPED | PACKV_STALE );
+	packv.skip_run = 0;
+
+	packv.sig1_mv = PACKV_SIG1_TO_MV( sig1 );
+	packv.sum_mv = pack.vsum_mv;
+	packv.diff_mv = packv.sig1_mv - packv.sum_mv;
+	packv.compare_cnt++;
+	d = ( packv.diff_mv < 0 ) ? -packv.diff_mv : packv.diff_mv;
+	if( d > packv.diff_max ) packv.diff_max = d;
+
+	if( d > PACKV_TOL_MV ){
+		if(( packv.status & PACKV_MISMATCH ) == 0x00 ) packv.mismatch_cnt++;
+		packv.status |= PACKV_MISMATCH;
+		return( TRIP_MARGINAL );
+	}
+	packv.status &= ~PACKV_MISMATCH;
+	return( TRIP_OK );
+}
+
+/*
+ * No comparison this sweep, PACKV_STALE once too many in a row
+ */
+static unsigned char packv_skip( void )
+{
+	packv.status |= PACKV_SKIPPED;
+	packv.skip_cnt++;
+	if( packv.skip_run < PACKV_STALE_SWEEPS ){
+		if( ++packv.skip_run == PACKV_STALE_SWEEPS ){
+			packv.status |= PACKV_STALE;
+			packv.stale_cnt++;
+		}
+	}
+	return( TRIP_OK );
+}
@@ -0,0 +1,59 @@
+/*
+ * Redundant pack voltage cross check
+ *
+ * Compares the sum of the LTC cell voltages with SIG1, the pack voltage
+ * seen through the precharge divider on the misc ADC, once per LTC sweep:
+ *
+ *		| V_sig1  -  sum( V_cell ) |  <  PACKV_TOL_MV
+ *
+ * A stack whose readings have gone stale or stuck leaves the sum behind the
+ * real pack voltage and fails the comparison on the next sweep, without
+ * waiting for PEC errors. The LTCs convert at different times than SIG1 is
+ * read, so a sweep is skipped when the current has moved by more than
+ * PACKV_DI_MAX_DA since any of the three conversions (IR drop), and when
+ * SIG1 is below PCHG_SIG1_MIN (divider not powered, or no valid reading).
+ * The divider is read through the external precharge relay, which mc_close
+ * opens, so outside PRECHARGE SIG1 may not be there at all: after
+ * PACKV_STALE_SWEEPS skipped sweeps in a row PACKV_STALE is set, rather than
+ * the check lapsing unnoticed. The status goes out on BP_PACKV every 2 sec,
+ * and at the BP_LIMITS rate while PACKV_STALE or PACKV_MISMATCH is set.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef PACKV_H_
+#define PACKV_H_
+
+// Public function prototypes
+extern unsigned char	packv_check( unsigned long sig1, long code );
+
+// SIG1 ADC code to mV: PCHG_SIG1_MIN (0x900000) is 92.4 V, ( code >> 8 ) * 2567 >> 10
+#define PACKV_SIG1_TO_MV(c)		((long)((((c) >> 8) * 2567UL) >> 10))
+
+#define PACKV_TOL_MV			4000L		// Allowed difference, divider and LTC errors (~3 %)
+#define PACKV_DI_MAX_DA			50			// Largest current change since the conversions (5 A)
+#define PACKV_STALE_SWEEPS		30			// Skipped sweeps in a row before PACKV_STALE (~30 sec)
+
+// Status bits (packv.status)
+#define PACKV_SKIPPED			0x01		// No comparison on the last sweep
+#define PACKV_MISMATCH			0x02		// Last comparison out of tolerance
+#define PACKV_STALE				0x04		// No comparison for PACKV_STALE_SWEEPS sweeps
+
+typedef struct _packv_state
+{
+  long				sig1_mv;			// SIG1 pack voltage
+  long				sum_mv;				// LTC cell sum
+  long				diff_mv;			// sig1_mv - sum_mv
+  long				diff_max;			// Largest |diff_mv| compared
+  unsigned int		compare_cnt;		// Comparisons made
+  unsigned int		skip_cnt;			// Sweeps skipped
+  unsigned int		skip_run;			// Sweeps skipped since the last comparison
+  unsigned int		stale_cnt;			// Transitions into PACKV_STALE
+  unsigned int		mismatch_cnt;		// Transitions into PACKV_MISMATCH
+  unsigned char		status;
+} packv_state;
+
+extern packv_state		packv;
+
+#endif /*PACKV_H_*/
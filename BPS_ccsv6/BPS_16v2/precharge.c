@@ -0,0 +1,117 @@
+/*
+ * Precharge completion from the RC charging curve
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - precharge_update runs every tick while in PRECHARGE, once the precharge
+ *   contactor has pulled in, and the fit times run from its first valid
+ *   sample, so the contactor delay does not count as charging time
+ * - Halving times avoid a logarithm: t_half = RC * ln 2, and the halvings still
+ *   needed to reach the convergence threshold are counted by shifting
+ * - Caps that are already charged (small d0) converge on the first samples,
+ *   that is not a fault
+ * - PCHG_TIMEOUT_MS also runs while SIG1 is invalid, whether it has not come
+ *   up yet or was lost after the fit started
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "precharge.h"
+
+// Public variables
+precharge_status		pchg;
+
+#define PCHG_MS_TO_TICKS(ms)	((unsigned int)(((unsigned long)(ms) * TICK_RATE) / 1000UL))
+
+/*
+ * Starts a new fit, on entry to PRECHARGE
+ */
+void precharge_start( void )
+{
+	extern volatile unsigned int tick_count;
+
+	pchg.state = PCHG_CHARGING;
+	pchg.fault = 0x00;
+	pchg.halvings = 0;
+	pchg.conv_cnt = 0;
+	pchg.start = tick_count;
+	pchg.elapsed = 0;
+	pchg.d0 = 0;
+	pchg.diff = 0;
+	pchg.t_half = 0;
+	pchg.t_pred = 0;
+	pchg.t_done = 0;
+}
+
+/*
+ * One sample of the precharge signals (raw misc ADC codes)
+ *	- Returns a PCHG_ERR_xxx fault code, or 0
+ */
+unsigned char precharge_update( unsigned long sig1, unsigned long sig2, unsigned long sig3 )
+{
+	extern volatile unsigned int tick_count;
+	unsigned long thr, d;
+	unsigned char n;
+
+	if(( pchg.state == PCHG_IDLE ) || ( pchg.state == PCHG_FAULT ) || ( pchg.state == PCHG_MC_READY )) return( 0x00 );
+	pchg.elapsed = tick_count - pchg.start;
+	if( sig1 <= PCHG_SIG1_MIN ){								//no valid battery reading, not yet or lost
+		if(( pchg.fault == 0x00 ) && ( pchg.elapsed >= PCHG_MS_TO_TICKS( PCHG_TIMEOUT_MS ))){
+			pchg.fault = PCHG_ERR_TIMEOUT;
+			pchg.state = PCHG_FAULT;
+		}
+		return( pchg.fault );
+	}
+
+	thr = sig1 >> PCHG_CONV_SHIFT;
+
+	if( pchg.state == PCHG_CHARGING ){
+		pchg.diff = ( sig1 > sig2 ) ? ( sig1 - sig2 ) : ( sig2 - sig1 );
+		if( pchg.d0 == 0 ){										//times run from the first valid sample
+			pchg.d0 = pchg.diff | 1;
+			pchg.start = tick_count;
+			pchg.elapsed = 0;
+		}
+
+		// Halving times, averaged over all halvings so far
+		while(( pchg.halvings < 24 ) && ( pchg.diff < ( pchg.d0 >> ( pchg.halvings + 1 )))){
+			pchg.halvings++;
+			pchg.t_half = pchg.elapsed / pchg.halvings;
+			if( pchg.t_half < PCHG_MS_TO_TICKS( PCHG_THALF_MIN_MS ) && ( pchg.d0 >= ( thr << 2 ))){
+				pchg.fault = PCHG_ERR_FAST;
+			}
+		}
+
+		// Completion estimate: halvings from d0 down to the threshold
+		if( pchg.t_half != 0 ){
+			for( n = 0, d = pchg.d0; d >= thr; d >>= 1 ) n++;
+			pchg.t_pred = pchg.t_half * n;
+		}
+
+		if(( pchg.diff < thr ) && ( sig2 > PCHG_SIG_NOISE )){
+			if( ++pchg.conv_cnt >= PCHG_CONV_SAMPLES ){
+				pchg.state = PCHG_CHARGED;
+				pchg.t_done = pchg.elapsed;
+			}
+		}
+		else pchg.conv_cnt = 0;
+
+		if( pchg.state == PCHG_CHARGING && pchg.fault == 0x00 ){
+			if(( pchg.elapsed >= PCHG_MS_TO_TICKS( PCHG_STALL_MS )) && ( pchg.diff > ( pchg.d0 - ( pchg.d0 >> 3 )))){
+				pchg.fault = PCHG_ERR_STALL;
+			}
+			else if(( pchg.elapsed >= PCHG_MS_TO_TICKS( PCHG_TIMEOUT_MS )) || ( pchg.t_pred > PCHG_MS_TO_TICKS( PCHG_TIMEOUT_MS ))){
+				pchg.fault = PCHG_ERR_TIMEOUT;
+			}
+		}
+	}
+	else{	// PCHG_CHARGED
+		d = ( sig2 > sig3 ) ? ( sig2 - sig3 ) : ( sig3 - sig2 );
+		if(( d < ( sig2 >> PCHG_CONV_SHIFT )) && ( sig3 > PCHG_SIG_NOISE )) pchg.state = PCHG_MC_READY;
+		else if(( pchg.elapsed - pchg.t_done ) >= PCHG_MS_TO_TICKS( PCHG_MC_TIMEOUT_MS )) pchg.fault = PCHG_ERR_MC;
+	}
+
+	if( pchg.fault != 0x00 ) pchg.state = PCHG_FAULT;
+	return( pchg.fault );
+}
@@ -0,0 +1,66 @@
+/*
+ * Precharge completion from the RC charging curve
+ *
+ * With the precharge contactor closed the difference between the battery
+ * (SIG1) and the precharged side (SIG2) decays as exp(-t/RC). The time for
+ * each halving of that difference gives RC, and from it the time the
+ * difference will need to reach the convergence threshold. Precharge is
+ * complete as soon as the difference has converged, instead of after a
+ * fixed wait. A difference that does not fall, falls faster than the
+ * precharge resistor allows, or is predicted to miss the timeout is a
+ * precharge fault (resistor or contactor failed).
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef PRECHARGE_H_
+#define PRECHARGE_H_
+
+// Public function prototypes
+extern void				precharge_start( void );
+extern unsigned char	precharge_update( unsigned long sig1, unsigned long sig2, unsigned long sig3 );
+
+// States
+#define PCHG_IDLE				0
+#define PCHG_CHARGING			1			// Waiting for SIG2 to converge on SIG1
+#define PCHG_CHARGED			2			// Converged, waiting for SIG3 (MC side) to follow
+#define PCHG_MC_READY			3			// MC may close
+#define PCHG_FAULT				4
+
+// Fault codes (batt_ERR, DR LEDs show 0x7)
+#define PCHG_ERR_STALL			0x71		// Difference not falling: resistor or precharge contactor open
+#define PCHG_ERR_FAST			0x72		// Halved faster than the resistor allows: resistor shorted
+#define PCHG_ERR_TIMEOUT		0x73		// Not converged, or predicted not to, by PCHG_TIMEOUT_MS
+#define PCHG_ERR_MC				0x74		// SIG3 did not follow SIG2
+
+// Raw misc ADC codes, R divider ~0.01525
+#define PCHG_SIG1_MIN			0x00900000	// Valid battery reading, 92.4 V
+#define PCHG_SIG_NOISE			0x00800000	// SIG2 / SIG3 below this is noise
+#define PCHG_CONV_SHIFT			5			// Converged: difference < SIG1 / 32 (~3 %)
+#define PCHG_CONV_SAMPLES		3			// Consecutive converged samples
+
+// Times (ms)
+#define PCHG_STALL_MS			500			// Must have fallen by 1/8 by then
+#define PCHG_THALF_MIN_MS		20			// Shortest plausible halving time
+#define PCHG_TIMEOUT_MS			5000		// Contactor close to converged
+#define PCHG_MC_TIMEOUT_MS		1000		// Converged to SIG3 following
+
+typedef struct _precharge_status
+{
+  unsigned char		state;
+  unsigned char		fault;				// PCHG_ERR_xxx, 0 = none
+  unsigned char		halvings;			// Times the difference has halved from d0
+  unsigned char		conv_cnt;			// Consecutive converged samples
+  unsigned int		start;				// tick_count at precharge_start
+  unsigned int		elapsed;			// Ticks since precharge_start
+  unsigned long		d0;					// SIG1 - SIG2 at the first valid sample
+  unsigned long		diff;				// Latest SIG1 - SIG2
+  unsigned int		t_half;				// Average ticks per halving, 0 = none yet
+  unsigned int		t_pred;				// Predicted ticks from start to converged, 0 = no estimate
+  unsigned int		t_done;				// Ticks from start to converged
+} precharge_status;
+
+extern precharge_status	pchg;
+
+#endif /*PRECHARGE_H_*/
@@ -0,0 +1,117 @@
+/*
+ * Execution time probes
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - A probe costs two probe_time() reads and the statistics update, a few us
+ *   at MCLK = 16 MHz
+ * - The ISRs don't nest, so an ISR probe never overlaps another ISR probe,
+ *   but a task probe includes the ISRs that ran during the task
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "probe.h"
+#include "sched.h"
+
+// Public variables
+probe_stats				probe[PROBE_COUNT];
+
+// Private variables
+static volatile unsigned int	probe_hi = 0;		// Timer A0 overflows, upper 16 bits of probe_time
+
+static const char * const isr_names[PROBE_COUNT - PROBE_TASKS] = { "isr tick", "isr rs232", "isr port1", "isr port2" };
+
+/*
+ * Starts Timer A0 free running at SMCLK/8 with the overflow interrupt
+ */
+void probe_init( void )
+{
+	TA0CTL = TASSEL_2 | ID_3 | MC_2 | TACLR | TAIE;		// SMCLK/8 = 1 MHz, continuous
+	probe_clear();
+}
+
+void probe_clear( void )
+{
+	unsigned char n, k;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	for( n = 0; n < PROBE_COUNT; n++ ){
+		probe[n].count = 0;
+		probe[n].min = 0xFFFFFFFF;
+		probe[n].max = 0;
+		probe[n].sum = 0;
+		for( k = 0; k < PROBE_BINS; k++ ) probe[n].hist[k] = 0;
+	}
+	__bis_SR_register( sr & GIE );
+}
+
+/*
+ * Microseconds since probe_init (wraps after 71 minutes)
+ *	- If TA0R has wrapped but the overflow ISR has not run yet, count the overflow here
+ *	- Called with interrupts off the ISR can't run, so the overflow is taken
+ *	  over here; a wait with interrupts off stays timed correctly as long as it
+ *	  calls probe_time at least once per Timer A0 wrap (65 ms)
+ */
+unsigned long probe_time( void )
+{
+	unsigned int hi, lo;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	lo = TA0R;
+	if(( TA0CTL & TAIFG ) && (( sr & GIE ) == 0 )){
+		TA0CTL &= ~TAIFG;
+		probe_hi++;
+		lo = TA0R;
+	}
+	hi = probe_hi;
+	if(( TA0CTL & TAIFG ) && ( lo < 0x8000 )) hi++;
+	__bis_SR_register( sr & GIE );
+	return((( unsigned long ) hi << 16 ) | lo );
+}
+
+void probe_begin( unsigned char id )
+{
+	probe[id].start = probe_time();
+}
+
+void probe_end( unsigned char id )
+{
+	probe_stats *p;
+	unsigned long dt, v;
+	unsigned char bin;
+
+	p = &probe[id];
+	dt = probe_time() - p->start;
+	p->count++;
+	p->sum += dt;
+	if( dt < p->min ) p->min = dt;
+	if( dt > p->max ) p->max = dt;
+	bin = 0;
+	for( v = dt >> 1; ( v != 0 ) && ( bin < PROBE_BINS - 1 ); v >>= 1 ) bin++;
+	if( p->hist[bin] != 0xFFFF ) p->hist[bin]++;
+}
+
+/*
+ * Task name from the scheduler table, or the ISR name
+ */
+const char *probe_name( unsigned char id )
+{
+	if( id >= PROBE_COUNT ) return( "" );
+	if( id >= PROBE_TASKS ) return( isr_names[id - PROBE_TASKS] );
+	if( id < sched_count ) return( sched_table[id].name );
+	return( "" );
+}
+
+/*
+ * Timer A0 overflow, every 65.536 ms, called from the TIMER0_A1 ISR
+ */
+void probe_overflow_int( void )
+{
+	probe_hi++;
+}
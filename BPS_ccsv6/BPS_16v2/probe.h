@@ -0,0 +1,48 @@
+/*
+ * Execution time probes
+ *
+ * Timer A0 runs free at SMCLK/8 = 1 MHz and its overflow interrupt extends it
+ * to a 32 bit microsecond timestamp (probe_time). probe_begin/probe_end pairs
+ * around each scheduler task and ISR record the count, min/avg/max and a log2
+ * histogram of the time between them. The results are listed by the RS232
+ * "probe stats" command and sent one probe per BP_PROBE frame on CAN.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef PROBE_H_
+#define PROBE_H_
+
+// Public function prototypes
+extern void				probe_init( void );
+extern unsigned long	probe_time( void );
+extern void				probe_begin( unsigned char id );
+extern void				probe_end( unsigned char id );
+extern void				probe_clear( void );
+extern const char		*probe_name( unsigned char id );
+extern void				probe_overflow_int( void );
+
+// Probe ids: scheduler tasks use their table index, the ISRs follow
+#define PROBE_TASKS			8			// Task ids 0..7
+#define PROBE_ISR_TICK		8			// Timer B tick
+#define PROBE_ISR_RS232		9			// USCI_A3
+#define PROBE_ISR_PORT1		10			// Buttons
+#define PROBE_ISR_PORT2		11			// CAN_INTn
+#define PROBE_COUNT			12
+
+#define PROBE_BINS			16			// Bin n counts times of 2^n..2^(n+1)-1 us, the last bin all longer
+
+typedef struct _probe_stats
+{
+  unsigned long		start;				// probe_time() at probe_begin
+  unsigned long		count;
+  unsigned long		min;				// us
+  unsigned long		max;				// us
+  unsigned long long	sum;			// us, for the average
+  unsigned int		hist[PROBE_BINS];	// Saturate at 0xFFFF
+} probe_stats;
+
+extern probe_stats		probe[PROBE_COUNT];
+
+#endif /*PROBE_H_*/
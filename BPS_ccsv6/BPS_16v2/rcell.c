@@ -0,0 +1,136 @@
+/*
+ * Online cell internal resistance estimate
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - rcell_sync after LTCn_Start_ADCCV with the shunt read at that time,
+ *   rcell_update after a good LTCn_Read_Voltages, both from the LTC task
+ * - For one parameter the RLS gain and covariance reduce to the forgetting
+ *   sums Sxx and Sxy, kept in integers; the one float divide per cell only
+ *   happens on a current step
+ * - A UV flag is only cleared when every cell of that LTC is back above
+ *   Vuv once its own I * R (at most RCELL_COMP_MAX_MV) is added, and only
+ *   while discharging, never below RCELL_UV_FLOOR_MV and for at most
+ *   RCELL_UV_MASK_TICKS at a time
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "rcell.h"
+#include "limits.h"
+
+// Public variables
+rcell_state				rcell;
+
+// First pack cell and cell count of each LTC
+static const unsigned char ltc_first[RCELL_LTCS] = { 0, 11, 23 };
+static const unsigned char ltc_cells[RCELL_LTCS] = { 11, 12, 12 };
+
+// Private function prototypes
+static unsigned int		*ltc_codes( unsigned char ltc );
+
+/*
+ * Every cell back to the LIM_R_CELL prior
+ */
+void rcell_init( void )
+{
+	unsigned char n;
+
+	for( n = 0; n < RCELL_CELLS; n++ ){
+		rcell.sxx[n] = RCELL_PRIOR_SXX;
+		rcell.sxy[n] = (long)( RCELL_PRIOR_SXX * LIM_R_CELL / RCELL_UOHM_PER_XY );
+		rcell.r_uohm[n] = LIM_R_CELL;
+	}
+	rcell.have_prev = 0x00;
+	rcell.steps = 0;
+	rcell.uv_masked = 0;
+	rcell.uv_run = 0x00;
+}
+
+/*
+ * Current at the start of an LTC conversion, code is diff_shunt - diff_ref
+ */
+void rcell_sync( unsigned char ltc, long code )
+{
+	if( ltc >= RCELL_LTCS ) return;
+	rcell.i_da[ltc] = (int) RCELL_CODE_TO_DA( code );
+}
+
+/*
+ * Fits the new cell voltages of ltc against the current step since its last conversion
+ */
+void rcell_update( unsigned char ltc )
+{
+	unsigned int *cv;
+	unsigned char n, c;
+	long x, y;
+	float r;
+
+	if( ltc >= RCELL_LTCS ) return;
+	cv = ltc_codes( ltc );
+	x = (long) rcell.i_da[ltc] - rcell.i_cv[ltc];
+
+	if(( rcell.have_prev & ( 1 << ltc )) && (( x >= RCELL_STEP_DA ) || ( x <= -RCELL_STEP_DA ))){
+		for( n = 0, c = ltc_first[ltc]; n < ltc_cells[ltc]; n++, c++ ){
+			y = (long) rcell.prev_cv[c] - (long) cv[n];
+			rcell.sxx[c] += x * x - ( rcell.sxx[c] >> RCELL_FORGET_SHIFT );
+			rcell.sxy[c] += x * y - ( rcell.sxy[c] >> RCELL_FORGET_SHIFT );
+			r = ( (float) rcell.sxy[c] * RCELL_UOHM_PER_XY ) / (float) rcell.sxx[c];
+			if( r < RCELL_R_MIN ) r = RCELL_R_MIN;
+			if( r > RCELL_R_MAX ) r = RCELL_R_MAX;
+			rcell.r_uohm[c] = (unsigned int) r;
+		}
+		rcell.steps++;
+	}
+
+	for( n = 0, c = ltc_first[ltc]; n < ltc_cells[ltc]; n++, c++ ) rcell.prev_cv[c] = cv[n];
+	rcell.i_cv[ltc] = rcell.i_da[ltc];
+	rcell.have_prev |= 1 << ltc;
+}
+
+/*
+ * TRUE if a UV flag of ltc is explained by the IR drop, from the last voltages read
+ *	- Never for a cell under RCELL_UV_FLOOR_MV as read, whatever the current
+ *	- Reads masked no more than RCELL_UV_GAP_TICKS apart are one run, which
+ *	  is not masked past RCELL_UV_MASK_TICKS: the flag then reaches the trip
+ *	  filter until it has been clear for RCELL_UV_GAP_TICKS
+ */
+unsigned char rcell_uv_ok( unsigned char ltc )
+{
+	extern volatile unsigned int tick_count;
+	unsigned int *cv;
+	unsigned char n, c, bit;
+	int mv;
+	long comp;
+
+	if(( ltc >= RCELL_LTCS ) || (( rcell.have_prev & ( 1 << ltc )) == 0x00 )) return( FALSE );
+	if( rcell.i_cv[ltc] <= 0 ) return( FALSE );
+	cv = ltc_codes( ltc );
+	for( n = 0, c = ltc_first[ltc]; n < ltc_cells[ltc]; n++, c++ ){
+		mv = LTC_CODE_TO_MV( cv[n] );
+		if( mv < RCELL_UV_FLOOR_MV ) return( FALSE );
+		comp = ( (long) rcell.i_cv[ltc] * rcell.r_uohm[c] ) / 10000L;		// 0.1 A * uOhm to mV
+		if( comp > RCELL_COMP_MAX_MV ) comp = RCELL_COMP_MAX_MV;
+		if(( mv + comp ) < RCELL_UV_MV ) return( FALSE );
+	}
+
+	bit = 1 << ltc;
+	if((( rcell.uv_run & bit ) == 0x00 ) || (( tick_count - rcell.uv_last[ltc] ) > RCELL_UV_GAP_TICKS )){
+		rcell.uv_start[ltc] = tick_count;
+		rcell.uv_run |= bit;
+	}
+	rcell.uv_last[ltc] = tick_count;
+	if(( tick_count - rcell.uv_start[ltc] ) > RCELL_UV_MASK_TICKS ) return( FALSE );
+	rcell.uv_masked++;
+	return( TRUE );
+}
+
+static unsigned int *ltc_codes( unsigned char ltc )
+{
+	extern unsigned int ltc1_cv[12], ltc2_cv[12], ltc3_cv[12];
+
+	if( ltc == 1 ) return( ltc2_cv );
+	if( ltc == 2 ) return( ltc3_cv );
+	return( ltc1_cv );
+}
@@ -0,0 +1,66 @@
+/*
+ * Online cell internal resistance estimate
+ *
+ * The shunt is read right after each LTC conversion is started, so every
+ * set of cell voltages has the pack current it was measured at. Between two
+ * conversions of the same LTC the open circuit voltage hardly moves, so a
+ * current step dI gives dV = -R * dI for each cell. R is fitted per cell by
+ * recursive least squares with exponential forgetting, on steps of at least
+ * RCELL_STEP_DA, starting from a prior of LIM_R_CELL. The estimates feed
+ * the voltage taper of the current limits and the IR drop compensation of
+ * the LTC undervoltage flags.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef RCELL_H_
+#define RCELL_H_
+
+// Public function prototypes
+extern void				rcell_init( void );
+extern void				rcell_sync( unsigned char ltc, long code );
+extern void				rcell_update( unsigned char ltc );
+extern unsigned char	rcell_uv_ok( unsigned char ltc );
+
+// Cells per LTC and their place in the pack (LTC1 11 cells, LTC2 and LTC3 12)
+#define RCELL_LTCS				3
+#define RCELL_CELLS				35
+
+// Shunt ADC code (diff_shunt - diff_ref) to 0.1 A, + = discharge
+#define RCELL_CODE_TO_DA(c)		((((c) >> 8) * 1338L) >> 16)		// I2T_FS_DA scale, signed
+
+// Fit: x = dI (0.1 A), y = -dV (LTC codes, 1.5 mV), R = RCELL_UOHM_PER_XY * Sxy / Sxx
+#define RCELL_UOHM_PER_XY		15000.0
+#define RCELL_STEP_DA			50			// Smallest current step used (5 A)
+#define RCELL_FORGET_SHIFT		4			// Forgetting factor 1 - 1/16 per step
+#define RCELL_PRIOR_SXX			10000L		// Weight of the LIM_R_CELL prior, one 10 A step
+#define RCELL_R_MIN				500L		// Estimate clamp (uOhm)
+#define RCELL_R_MAX				20000L
+
+// Undervoltage compensation
+#define RCELL_UV_MV				2640		// LTC Vuv (CFGR4)
+#define RCELL_COMP_MAX_MV		400			// Largest IR drop credited to a cell
+#define RCELL_UV_FLOOR_MV		2400		// A loaded cell below this is never masked
+#define RCELL_UV_MASK_TICKS		(10 * TICK_RATE)		// Longest a UV flag stays masked
+#define RCELL_UV_GAP_TICKS		(2 * LTC_STATUS_COUNT)	// Longer without a masked read ends it
+
+typedef struct _rcell_state
+{
+  long				sxx[RCELL_CELLS];
+  long				sxy[RCELL_CELLS];
+  unsigned int		r_uohm[RCELL_CELLS];	// Estimates, clamped
+  unsigned int		prev_cv[RCELL_CELLS];	// Codes of the previous conversion
+  int				i_da[RCELL_LTCS];		// Current at the last conversion start
+  int				i_cv[RCELL_LTCS];		// Current at the conversion of prev_cv
+  unsigned char		have_prev;				// Bit per LTC, prev_cv / i_cv valid
+  unsigned int		steps;					// Current steps fitted
+  unsigned int		uv_masked;				// UV flag reads cleared by the compensation
+  unsigned int		uv_start[RCELL_LTCS];	// tick_count of the first read masked in a row
+  unsigned int		uv_last[RCELL_LTCS];	// tick_count of the last masked read
+  unsigned char		uv_run;					// Bit per LTC, uv_start valid
+} rcell_state;
+
+extern rcell_state		rcell;
+
+#endif /*RCELL_H_*/
@@ -0,0 +1,221 @@
+/*
+ * Contactor sequencer
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - relay_tick runs in the timer B ISR, everything shared with it is changed
+ *   with interrupts held off
+ * - The coils are driven straight from port pins, there is no economizer
+ *   (hold current) hardware, so the pull-in time only sets when a contactor
+ *   counts as closed
+ * - The readback is of the port output latches, the contactors have no
+ *   auxiliary contacts
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "relay.h"
+
+// Public variables
+relay_status			relay;
+
+// Open sequence: each step opens its contactors delay ticks after the previous one
+typedef struct _relay_step
+{
+  unsigned char		mask;
+  unsigned char		delay;
+} relay_step;
+
+static const relay_step open_all_seq[] =
+{
+	{ RLY_DRIVE,	0 },					// Break the load first
+	{ RLY_BATT,		RELAY_STEP_TICKS },
+	{ RLY_ARRAY,	RELAY_STEP_TICKS },
+};
+
+#define OPEN_ALL_STEPS	(sizeof(open_all_seq) / sizeof(open_all_seq[0]))
+
+// Private variables
+static unsigned char	seq_step = OPEN_ALL_STEPS;	// Next step, OPEN_ALL_STEPS = idle
+static unsigned char	seq_count = 0;				// Ticks to the next step
+static unsigned char	rly_timer[RLY_COUNT];		// Pull-in / drop-out ticks left
+
+// Private function prototypes
+static void				relay_drive( unsigned char mask, unsigned char close );
+static unsigned char	relay_latch( void );
+static void				relay_release( unsigned char mask );
+static void				relay_timer_start( unsigned char mask, unsigned char ticks );
+
+/*
+ * All contactors open at once (power up, nothing closed yet)
+ */
+void relay_init( void )
+{
+	unsigned char n;
+
+	relay_drive( RLY_ALL, FALSE );
+	relay.cmd = 0x00;
+	relay.closed = 0x00;
+	relay.moving = 0x00;
+	relay.readback_err = 0;
+	relay.open_all_cnt = 0;
+	seq_step = OPEN_ALL_STEPS;
+	for( n = 0; n < RLY_COUNT; n++ ) rly_timer[n] = 0;
+}
+
+/*
+ * Opens every contactor in order
+ *	- The drive (MC, precharge) contactors open before this returns, the battery
+ *	  and array contactors follow from the tick
+ *	- Safe to call repeatedly, a sequence already running is not restarted
+ */
+void relay_open_all( void )
+{
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	relay_release( open_all_seq[0].mask );
+	if(( seq_step >= OPEN_ALL_STEPS ) && (( relay.cmd & RLY_ALL ) != 0x00 )){
+		seq_step = 1;
+		seq_count = open_all_seq[1].delay;
+		relay.open_all_cnt++;
+	}
+	__bis_SR_register( sr & GIE );
+}
+
+/*
+ * Opens the contactors in mask now
+ */
+void relay_open( unsigned char mask )
+{
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	relay_release( mask );
+	__bis_SR_register( sr & GIE );
+}
+
+/*
+ * Closes the contactors in mask
+ *	- Refused (returns FALSE) while an open sequence is running
+ */
+unsigned char relay_close( unsigned char mask )
+{
+	unsigned char newly;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	if( seq_step < OPEN_ALL_STEPS ){
+		__bis_SR_register( sr & GIE );
+		return( FALSE );
+	}
+	newly = mask & ~relay.cmd & RLY_ALL;
+	relay.cmd |= newly;
+	relay_drive( newly, TRUE );
+	relay_timer_start( newly, RELAY_PULLIN_TICKS );
+	__bis_SR_register( sr & GIE );
+	return( TRUE );
+}
+
+/*
+ * TRUE while an open sequence still has steps to run
+ */
+unsigned char relay_busy( void )
+{
+	return( seq_step < OPEN_ALL_STEPS );
+}
+
+/*
+ * Steps the open sequence, the pull-in / drop-out times and the readback, every tick
+ */
+void relay_tick( void )
+{
+	unsigned char n, bit, latch;
+
+	if( seq_step < OPEN_ALL_STEPS ){
+		if( seq_count != 0 ) seq_count--;
+		while(( seq_step < OPEN_ALL_STEPS ) && ( seq_count == 0 )){
+			relay_release( open_all_seq[seq_step].mask );
+			seq_step++;
+			if( seq_step < OPEN_ALL_STEPS ) seq_count = open_all_seq[seq_step].delay;
+		}
+	}
+
+	for( n = 0, bit = 0x01; n < RLY_COUNT; n++, bit <<= 1 ){
+		if( rly_timer[n] == 0 ) continue;
+		if( --rly_timer[n] != 0 ) continue;
+		relay.moving &= ~bit;
+		if( relay.cmd & bit ) relay.closed |= bit;
+	}
+
+	latch = relay_latch();
+	if( latch != relay.cmd ){
+		relay.readback_err++;
+		relay_drive( latch & ~relay.cmd, FALSE );
+		relay_drive( relay.cmd & ~latch, TRUE );
+	}
+}
+
+/*
+ * Opens the contactors in mask, interrupts must be off
+ *	- The pins are always driven open, the drop-out time only starts for
+ *	  contactors that were commanded closed
+ */
+static void relay_release( unsigned char mask )
+{
+	unsigned char changed;
+
+	mask &= RLY_ALL;
+	relay_drive( mask, FALSE );
+	changed = mask & relay.cmd;
+	relay.cmd &= ~mask;
+	relay.closed &= ~mask;
+	relay_timer_start( changed, RELAY_DROPOUT_TICKS );
+}
+
+static void relay_timer_start( unsigned char mask, unsigned char ticks )
+{
+	unsigned char n, bit;
+
+	for( n = 0, bit = 0x01; n < RLY_COUNT; n++, bit <<= 1 ){
+		if( mask & bit ) rly_timer[n] = ticks;
+	}
+	relay.moving |= mask;
+}
+
+static void relay_drive( unsigned char mask, unsigned char close )
+{
+	unsigned char p6 = 0x00;
+
+	if( mask & RLY_BATT ) p6 |= RELAY_BATT;
+	if( mask & RLY_ARRAY ) p6 |= RELAY_ARRAY;
+	if( mask & RLY_MCPC ) p6 |= RELAY_MCPC;
+	if( mask & RLY_MC ) p6 |= RELAY_MC;
+	if( close ){
+		P6OUT |= p6;
+		if( mask & RLY_EXT_MCPC ) P7OUT |= EXT_RELAY_MCPC;
+	}
+	else{
+		P6OUT &= ~p6;
+		if( mask & RLY_EXT_MCPC ) P7OUT &= ~EXT_RELAY_MCPC;
+	}
+}
+
+/*
+ * Contactors driven closed according to the port output latches
+ */
+static unsigned char relay_latch( void )
+{
+	unsigned char mask = 0x00;
+
+	if( P6OUT & RELAY_BATT ) mask |= RLY_BATT;
+	if( P6OUT & RELAY_ARRAY ) mask |= RLY_ARRAY;
+	if( P6OUT & RELAY_MCPC ) mask |= RLY_MCPC;
+	if( P6OUT & RELAY_MC ) mask |= RLY_MC;
+	if( P7OUT & EXT_RELAY_MCPC ) mask |= RLY_EXT_MCPC;
+	return( mask );
+}
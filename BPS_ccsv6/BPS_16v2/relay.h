@@ -0,0 +1,52 @@
+/*
+ * Contactor sequencer
+ *
+ * All contactor drive goes through here instead of the relay_xxx_open/close
+ * port macros. Opening for a fault drops the motor controller and precharge
+ * contactors at once, then the battery and array contactors a step later each,
+ * timed by the timer B tick so the caller never waits. Each contactor has a
+ * pull-in / drop-out time before it reads back as closed / open, and the port
+ * latches are checked against the commanded state every tick.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef RELAY_H_
+#define RELAY_H_
+
+// Public function prototypes
+extern void				relay_init( void );
+extern void				relay_tick( void );
+extern void				relay_open_all( void );
+extern void				relay_open( unsigned char mask );
+extern unsigned char	relay_close( unsigned char mask );
+extern unsigned char	relay_busy( void );
+
+// Contactor masks
+#define RLY_BATT			0x01		// Battery contactor (P6)
+#define RLY_ARRAY			0x02		// Array contactor (P6)
+#define RLY_MCPC			0x04		// Motor controller precharge contactor (P6)
+#define RLY_MC				0x08		// Motor controller contactor (P6)
+#define RLY_EXT_MCPC		0x10		// External precharge board relay (P7)
+#define RLY_COUNT			5
+#define RLY_ALL				0x1F
+#define RLY_DRIVE			(RLY_MC | RLY_MCPC | RLY_EXT_MCPC)
+
+// Timing (timer B ticks, 10 ms)
+#define RELAY_STEP_TICKS	2			// Between open steps: drive, then battery, then array
+#define RELAY_PULLIN_TICKS	5			// Coil energised to contacts made
+#define RELAY_DROPOUT_TICKS	2			// Coil released to contacts open
+
+typedef struct _relay_status
+{
+  unsigned char		cmd;				// Commanded closed
+  unsigned char		closed;				// Commanded closed and pulled in
+  unsigned char		moving;				// Within the pull-in or drop-out time
+  unsigned int		readback_err;		// Port latch found different from cmd (re-driven)
+  unsigned int		open_all_cnt;		// Open sequences started
+} relay_status;
+
+extern relay_status	relay;
+
+#endif /*RELAY_H_*/
@@ -0,0 +1,216 @@
+/*
+ * Cooperative deadline scheduler
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - The task table lives with the task code (BPSmain.c), the index of a task
+ *   in the table is its id for sched_release
+ * - Times are timer B clocks (sched_time), so jitter well under one 10 ms tick
+ *   still shows in the statistics
+ * - A periodic task released again before it started loses the older release,
+ *   which counts as a deadline miss
+ * - LPM0 rather than LPM3: SMCLK clocks the RS232 and SPI ports and the TX ring
+ *   drains in its ISR while the CPU sleeps. Every ISR that can release a task
+ *   (timer B, CAN_INTn, RS232 RX) clears LPM0 on exit
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "sched.h"
+#include "probe.h"
+
+// Public variables
+sched_task				*sched_table = 0;
+unsigned char			sched_count = 0;
+unsigned int			sched_duty = 0;
+unsigned int			sched_duty_max = 0;
+
+// Private variables
+static unsigned int		load_start = 0;		// sched_time() at the start of the window
+static unsigned int		load_sleep = 0;		// Timer counts spent in LPM0 this window
+
+// Private function prototypes
+static void				sched_load( void );
+
+/*
+ * Sets up the task table, first periodic release one period after the first tick
+ */
+void sched_init( sched_task *table, unsigned char count )
+{
+	unsigned char n;
+
+	sched_table = table;
+	sched_count = count;
+	for( n = 0; n < count; n++ ){
+		table[n].pending = FALSE;
+		table[n].countdown = table[n].period;
+	}
+	sched_clear();
+}
+
+/*
+ * Clears the task statistics
+ */
+void sched_clear( void )
+{
+	unsigned char n;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	for( n = 0; n < sched_count; n++ ){
+		sched_table[n].runs = 0;
+		sched_table[n].misses = 0;
+		sched_table[n].late_min = 0xFFFF;
+		sched_table[n].late_max = 0;
+		sched_table[n].exec_max = 0;
+	}
+	sched_duty_max = 0;
+	__bis_SR_register( sr & GIE );
+}
+
+/*
+ * Timer B clocks since reset (wraps), tick_count extended with TBR
+ *	- If TBR has wrapped but the tick ISR has not run yet, count the tick here
+ */
+unsigned int sched_time( void )
+{
+	extern volatile unsigned int tick_count;
+	unsigned int ticks, counts;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	_DINT();
+	counts = TBR;
+	ticks = tick_count;
+	if(( TBCCTL0 & CCIFG ) && ( counts < ( SCHED_COUNTS_PER_TICK / 2 ))) ticks++;
+	__bis_SR_register( sr & GIE );
+	return( ticks * SCHED_COUNTS_PER_TICK + counts );
+}
+
+/*
+ * Releases the periodic tasks that are due, called from the timer B tick ISR
+ */
+void sched_tick( void )
+{
+	sched_task *t;
+	unsigned char n;
+	unsigned int now;
+
+	now = sched_time();
+	for( n = 0, t = sched_table; n < sched_count; n++, t++ ){
+		if( t->period == 0 ) continue;
+		if( --t->countdown != 0 ) continue;
+		t->countdown = t->period;
+		if( t->pending ) t->misses++;
+		t->pending = TRUE;
+		t->release = now;
+	}
+}
+
+/*
+ * Releases a task now (event tasks, or an early run of a periodic task)
+ *	- Safe from an ISR, a task that is already pending keeps its first release
+ */
+void sched_release( unsigned char id )
+{
+	sched_task *t;
+	unsigned short sr;
+
+	if( id >= sched_count ) return;
+	t = &sched_table[id];
+	sr = __get_SR_register();
+	_DINT();
+	if( !t->pending ){
+		t->release = sched_time();
+		t->pending = TRUE;
+	}
+	__bis_SR_register( sr & GIE );
+}
+
+/*
+ * Runs the released task with the lowest priority number (table order breaks ties)
+ *	- Returns TRUE if a task ran, FALSE if there was nothing to do
+ */
+unsigned char sched_run( void )
+{
+	sched_task *t, *best;
+	unsigned char n;
+	unsigned int start, late, exec;
+	unsigned short sr;
+
+	best = 0;
+	for( n = 0, t = sched_table; n < sched_count; n++, t++ ){
+		if( t->pending && (( best == 0 ) || ( t->priority < best->priority ))) best = t;
+	}
+	if( best == 0 ) return( FALSE );
+
+	sr = __get_SR_register();
+	_DINT();
+	best->pending = FALSE;
+	start = sched_time();
+	late = start - best->release;
+	__bis_SR_register( sr & GIE );
+
+	n = best - sched_table;
+	if( n < PROBE_TASKS ) probe_begin( n );
+	best->handler();
+	if( n < PROBE_TASKS ) probe_end( n );
+
+	sr = __get_SR_register();
+	_DINT();
+	exec = sched_time() - start;
+	best->runs++;
+	if( late < best->late_min ) best->late_min = late;
+	if( late > best->late_max ) best->late_max = late;
+	if( exec > best->exec_max ) best->exec_max = exec;
+	if(( (unsigned long) late + exec ) > ( (unsigned long) best->deadline * SCHED_COUNTS_PER_TICK )) best->misses++;
+	__bis_SR_register( sr & GIE );
+	sched_load();
+	return( TRUE );
+}
+
+/*
+ * Sleeps in LPM0 until the next interrupt, unless a task is released
+ *	- The release check and the LPM0 entry (which sets GIE) are atomic, so a
+ *	  release from an ISR just before the sleep can't wait for the next tick
+ *	- Returns at once while interrupts are disabled (initialization)
+ */
+void sched_idle( void )
+{
+	unsigned char n;
+	unsigned int start;
+	unsigned short sr;
+
+	sr = __get_SR_register();
+	if(( sr & GIE ) == 0 ) return;
+	_DINT();
+	for( n = 0; n < sched_count; n++ ){
+		if( sched_table[n].pending ){
+			_EINT();
+			return;
+		}
+	}
+	start = sched_time();
+	__bis_SR_register( LPM0_bits | GIE );	// ISR clears LPM0 on exit
+	__no_operation();
+	load_sleep += sched_time() - start;
+	sched_load();
+}
+
+/*
+ * Closes the CPU load window once it is SCHED_LOAD_COUNTS long
+ */
+static void sched_load( void )
+{
+	unsigned int window;
+
+	window = sched_time() - load_start;
+	if( window < SCHED_LOAD_COUNTS ) return;
+	if( load_sleep > window ) load_sleep = window;
+	sched_duty = (unsigned int)(( (unsigned long)( window - load_sleep ) * 1000UL ) / window );
+	if( sched_duty > sched_duty_max ) sched_duty_max = sched_duty;
+	load_start += window;
+	load_sleep = 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Cooperative deadline scheduler
+ *
+ * Tasks run to completion from the main loop. Periodic tasks are released by
+ * the timer B tick, event tasks (period 0) by sched_release, usually from an
+ * ISR. sched_run starts the released task with the lowest priority number, so
+ * a long telemetry task can delay a safety task by at most its own run time.
+ * For each task the scheduler keeps the release to start time (jitter), the
+ * run time and the number of deadline misses ("task stats" on RS232).
+ * With nothing released, sched_idle sleeps in LPM0 until the next interrupt
+ * and the active/sleep split gives the CPU duty cycle.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+typedef struct _sched_task
+{
+  const char		*name;				// Short name for the stats listing
+  void				(*handler)( void );	// Runs to completion
+  unsigned int		period;				// Ticks between releases, 0 = sched_release only
+  unsigned int		deadline;			// Ticks from release to completion
+  unsigned char		priority;			// 0 = most urgent
+  // Run time state and statistics, zero in the table initializer
+  volatile unsigned char	pending;	// Released, not yet started
+  volatile unsigned int		countdown;	// Ticks to the next release
+  volatile unsigned int		release;	// sched_time() of the release
+  unsigned int		runs;
+  unsigned int		misses;				// Finished late, or released again before it ran
+  unsigned int		late_min;			// Release to start, timer counts
+  unsigned int		late_max;
+  unsigned int		exec_max;			// Start to finish, timer counts
+} sched_task;
+
+// Public function prototypes
+extern void				sched_init( sched_task *table, unsigned char count );
+extern void				sched_tick( void );
+extern void				sched_release( unsigned char id );
+extern unsigned char	sched_run( void );
+extern unsigned int		sched_time( void );
+extern void				sched_clear( void );
+extern void				sched_idle( void );
+
+// sched_time() counts timer B clocks, ACLK/8 = 244 us, wraps every 16 sec
+#define SCHED_COUNTS_PER_TICK	(ACLK_RATE / 8 / TICK_RATE + 1)		// TBCCR0 + 1, up mode
+#define SCHED_COUNTS_TO_US(c)	(((unsigned long)(c) * 15625UL) >> 6)	// 1e6 * 8 / 32768
+
+// CPU load, measured over SCHED_LOAD_TICKS windows
+#define SCHED_LOAD_TICKS		TICK_RATE						// 1 sec
+#define SCHED_LOAD_COUNTS		(SCHED_LOAD_TICKS * SCHED_COUNTS_PER_TICK)
+
+// Supply current estimate (uA, MSP430F5438A data sheet typical, 3 V, VCORE 3)
+//	- Active: MCLK = XT2 = 16 MHz executing from flash
+//	- LPM0: CPU and MCLK off, XT2, SMCLK and ACLK running for the USCIs and timers
+#define CPU_I_ACTIVE_UA			5300L
+#define CPU_I_LPM0_UA			350L
+#define CPU_I_EST_UA(duty)		(CPU_I_LPM0_UA + ((CPU_I_ACTIVE_UA - CPU_I_LPM0_UA) * (duty)) / 1000L)
+
+extern sched_task		*sched_table;
+extern unsigned char	sched_count;
+extern unsigned int		sched_duty;			// Active time over the last window (0.1 %)
+extern unsigned int		sched_duty_max;		// Highest window since sched_clear (0.1 %)
+
+#endif /*SCHED_H_*/
@@ -0,0 +1,172 @@
+/*
+ * Coulomb counting state of charge
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - soc_sample runs in the measure task on the raw shunt code with the
+ *   probe_time() of the reading, the interval is kept in 1.024 ms units and
+ *   the remainder carried to the next sample, so no time is lost or counted twice
+ * - No float and no division per sample: mA * interval goes into frac, and
+ *   whole counts move to q by a shift
+ * - The OCV table is for the NCR18650B cells at room temperature, and the
+ *   average cell voltage stands for the pack
+ * - Info flash: the erase of a segment stalls the CPU (interrupts included)
+ *   for ~25 ms, once every SOC_FLASH_SLOTS records; a record write is four
+ *   word writes. With SOC_SAVE_MIN_TICKS between records the 10^5 cycle
+ *   endurance of the segment lasts years of driving
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "soc.h"
+#include "limits.h"
+#include "flash.h"
+
+// Public variables
+soc_state				soc;
+
+// Average cell open circuit voltage (mV) at 0, 10, .. 100 %
+static const int ocv_mv[SOC_OCV_POINTS] =
+{
+	3000, 3400, 3500, 3580, 3630, 3680, 3750, 3840, 3930, 4030, 4150
+};
+
+// Private function prototypes
+static void				soc_recal( void );
+static void				soc_flash_write( unsigned char slot, long q );
+static unsigned int		soc_check( unsigned int tag, long q );
+
+/*
+ * Restores the charge from the last good flash record, at reset
+ */
+void soc_init( void )
+{
+	extern volatile unsigned int tick_count;
+	const soc_record *r = (const soc_record *) SOC_FLASH_ADDR;
+	unsigned char n;
+
+	soc.q = 0;
+	soc.frac = 0;
+	soc.ma = 0;
+	soc.t_last = 0;
+	soc.rest_us = 0;
+	soc.saves = 0;
+	soc.recals = 0;
+	soc.status = 0x00;
+	for( n = 0; n < SOC_FLASH_SLOTS; n++, r++ ){
+		if( r->tag == 0xFFFF ) break;
+		if(( r->tag == SOC_FLASH_TAG ) && ( r->check == soc_check( r->tag, r->q ))){
+			soc.q = r->q;
+			soc.status = SOC_VALID | SOC_FROM_FLASH;
+		}
+	}
+	soc.slot = n;
+	soc.saved = soc_permille();
+	soc.save_tick = tick_count;
+}
+
+/*
+ * One shunt sample: code is diff_shunt - diff_ref, t_sample its probe_time()
+ */
+void soc_sample( long code, unsigned long t_sample )
+{
+	unsigned long dt;
+	long units;
+
+	soc.ma = SOC_CODE_TO_MA( code );
+	dt = t_sample - soc.t_last;
+	if(( soc.t_last == 0 ) || ( dt > SOC_DT_MAX_US )){
+		soc.t_last = t_sample;
+		return;
+	}
+	units = (long)( dt >> SOC_DT_SHIFT );
+	soc.t_last += (unsigned long) units << SOC_DT_SHIFT;
+
+	soc.frac -= soc.ma * units;							// discharge lowers the charge
+	soc.q += soc.frac >> 10;
+	soc.frac &= 0x3FF;
+	if( soc.q < 0 ) soc.q = 0;
+	if( soc.q > SOC_Q_CAPACITY ) soc.q = SOC_Q_CAPACITY;
+
+	if(( soc.ma > SOC_REST_MA ) || ( soc.ma < -SOC_REST_MA )){
+		soc.rest_us = 0;
+		soc.status &= ~SOC_RESTED;
+	}
+	else if( soc.rest_us < SOC_REST_S * 1000000UL ) soc.rest_us += dt;
+
+	if((( soc.status & SOC_VALID ) == 0x00 )
+		|| (( soc.rest_us >= SOC_REST_S * 1000000UL ) && (( soc.status & SOC_RESTED ) == 0x00 ))) soc_recal();
+}
+
+/*
+ * Charge as 0.1 % of the capacity
+ */
+unsigned int soc_permille( void )
+{
+	return( (unsigned int)( soc.q / ( SOC_Q_CAPACITY / 1000 )));
+}
+
+/*
+ * Writes a flash record if the SOC has moved SOC_SAVE_DELTA since the last
+ * one and SOC_SAVE_MIN_TICKS have passed, from a slow task
+ */
+void soc_save( void )
+{
+	extern volatile unsigned int tick_count;
+	unsigned int now;
+
+	if(( soc.status & SOC_VALID ) == 0x00 ) return;
+	now = soc_permille();
+	if((( now > soc.saved ) ? ( now - soc.saved ) : ( soc.saved - now )) < SOC_SAVE_DELTA ) return;
+	if(( tick_count - soc.save_tick ) < SOC_SAVE_MIN_TICKS ) return;
+
+	if( soc.slot >= SOC_FLASH_SLOTS ) soc.slot = 0;		// segment full, erased by the write
+	soc_flash_write( soc.slot, soc.q );
+	soc.slot++;
+	soc.saved = now;
+	soc.save_tick = tick_count;
+	soc.saves++;
+}
+
+/*
+ * Sets the charge from the average cell voltage, interpolated in ocv_mv
+ *	- Waits for a full LTC sweep
+ */
+static void soc_recal( void )
+{
+	int mv;
+	unsigned char n;
+	unsigned int permille;
+
+	if(( pack.valid & PACK_VALID_V ) == 0x00 ) return;
+	mv = (int)( pack.vsum_mv / PACK_CELLS );
+	if( mv <= ocv_mv[0] ) permille = 0;
+	else if( mv >= ocv_mv[SOC_OCV_POINTS - 1] ) permille = 1000;
+	else{
+		for( n = 1; mv > ocv_mv[n]; n++ );
+		permille = ( n - 1 ) * 100 + (unsigned int)(( (long)( mv - ocv_mv[n - 1] ) * 100L ) / ( ocv_mv[n] - ocv_mv[n - 1] ));
+	}
+	soc.q = (long) permille * ( SOC_Q_CAPACITY / 1000 );
+	soc.frac = 0;
+	soc.status |= SOC_VALID | SOC_RESTED;
+	soc.recals++;
+}
+
+/*
+ * Programs one record, erasing the segment first when slot is 0
+ */
+static void soc_flash_write( unsigned char slot, long q )
+{
+	soc_record r;
+
+	r.tag = SOC_FLASH_TAG;
+	r.q = q;
+	r.check = soc_check( SOC_FLASH_TAG, q );
+	flash_write( (soc_record *) SOC_FLASH_ADDR + slot, &r, sizeof( r ) / 2, slot == 0 );
+}
+
+static unsigned int soc_check( unsigned int tag, long q )
+{
+	return( ~( tag ^ (unsigned int) q ^ (unsigned int)( q >> 16 )));
+}
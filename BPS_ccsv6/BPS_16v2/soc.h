@@ -0,0 +1,78 @@
+/*
+ * Coulomb counting state of charge
+ *
+ * Every shunt sample is integrated over its probe_time() interval into the
+ * charge left in the pack. The arithmetic is integer adds and shifts, one
+ * multiply per sample, so it would keep up with the shunt at kHz rates.
+ * After the pack has rested (|I| small) for SOC_REST_S the charge is reset
+ * from the average cell open circuit voltage. The charge is kept across
+ * resets in info flash segment D, one small record per SOC change of
+ * SOC_SAVE_DELTA, with the segment only erased once all its slots are used.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef SOC_H_
+#define SOC_H_
+
+// Public function prototypes
+extern void				soc_init( void );
+extern void				soc_sample( long code, unsigned long t_sample );
+extern void				soc_save( void );
+extern unsigned int		soc_permille( void );
+
+// Pack capacity, 12 parallel 3.35 Ah cells
+#define SOC_CAPACITY_MAH		40200L
+
+// Charge count: mA * 1.048576 sec (2^20 us), 3433 per mAh
+#define SOC_Q_PER_MAH			3433L
+#define SOC_Q_CAPACITY			(SOC_CAPACITY_MAH * SOC_Q_PER_MAH)
+#define SOC_DT_SHIFT			10			// Sample interval in 1.024 ms units
+#define SOC_DT_MAX_US			1000000UL	// Longer gaps (first sample, stalls) are not integrated
+
+// Shunt ADC code (diff_shunt - diff_ref) to mA, + = discharge: ( code >> 8 ) * 2090 >> 10
+#define SOC_CODE_TO_MA(c)		((((c) >> 8) * 2090L) >> 10)	// CURRENT_I_SCALE / 2^16
+
+// Voltage recalibration
+#define SOC_REST_MA				500L		// |I| below this counts as rest
+#define SOC_REST_S				600UL		// Rest time before the OCV is trusted
+#define SOC_OCV_POINTS			11			// Table points, 0 to 100 % in 10 % steps
+
+// Info flash
+#define SOC_FLASH_ADDR			0x1800		// INFOD, 128 bytes
+#define SOC_FLASH_SLOTS			16			// 8 byte records
+#define SOC_FLASH_TAG			0x50C1
+#define SOC_SAVE_DELTA			10			// 1 %, change needed for a new record
+#define SOC_SAVE_MIN_TICKS		(60 * TICK_RATE)	// And at least this long since the last one
+
+// Status bits (soc.status)
+#define SOC_VALID				0x01		// Charge known (flash record or OCV)
+#define SOC_FROM_FLASH			0x02		// Restored at reset
+#define SOC_RESTED				0x04		// OCV recalibration done for this rest
+
+typedef struct _soc_record
+{
+  unsigned int		tag;				// SOC_FLASH_TAG, 0xFFFF = empty slot
+  long				q;
+  unsigned int		check;				// ~( tag ^ q low ^ q high )
+} soc_record;
+
+typedef struct _soc_state
+{
+  long				q;					// Charge left (SOC_Q_PER_MAH counts)
+  long				frac;				// mA * 1.024 ms carried into q
+  long				ma;					// Last sample (mA, + = discharge)
+  unsigned long		t_last;				// probe_time() integrated up to
+  unsigned long		rest_us;			// Time at rest so far
+  unsigned int		saved;				// soc_permille() of the last record
+  unsigned int		save_tick;			// tick_count of the last record
+  unsigned int		saves;				// Records written since reset
+  unsigned int		recals;				// OCV recalibrations since reset
+  unsigned char		slot;				// Next free flash slot
+  unsigned char		status;
+} soc_state;
+
+extern soc_state		soc;
+
+#endif /*SOC_H_*/
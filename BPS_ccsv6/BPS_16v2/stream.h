@@ -0,0 +1,43 @@
+/*
+ * Binary telemetry stream over the isolated RS232 port
+ *
+ * While enabled, one frame is queued per current/temperature scan (or every
+ * Nth scan). Frames are COBS encoded with a 0x00 byte on both sides, so a
+ * receiver can resynchronise on any zero and skip text lines in between.
+ * Decoder: BPS_ccsv6/tools/bps_stream.py
+ *
+ * Frame (before COBS, little endian):
+ *	 0	u8		STREAM_VERSION
+ *	 1	u16		sequence number
+ *	 3	u32		timestamp (timer B ticks, 10 ms)
+ *	 7	u16[35]	cell codes, LTC1 cells 0-10, LTC2 11-22, LTC3 23-34
+ *	77	u24[40]	thermistor ADC codes, temperature_adc[0..39]
+ * 197	i32		shunt current (mA, + = discharge)
+ * 201	u8		BPS mode
+ * 202	u8		fault code (batt_ERR)
+ * 203	u8		flags, bit 0 batt_KILL, bit 1 LTC error, bit 2 pack voltage cross check stale
+ * 204	u16		CRC-16/CCITT-FALSE of bytes 0..203
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef STREAM_H_
+#define STREAM_H_
+
+// Public function prototypes
+extern void		stream_sample( unsigned char mode, unsigned char fault, unsigned char flags );
+extern void		stream_enable( unsigned char divider );
+
+#define STREAM_VERSION		0x01
+#define STREAM_RAW_SIZE		206			// Frame bytes including CRC
+#define STREAM_COBS_SIZE	(STREAM_RAW_SIZE + (STREAM_RAW_SIZE / 254) + 3)		// + overhead + delimiters
+
+#define STREAM_FLAG_KILL	0x01
+#define STREAM_FLAG_LTC		0x02
+#define STREAM_FLAG_PACKV	0x04		// PACKV_STALE
+
+extern unsigned char	stream_divider;		// 0 = off, N = one frame per N scans
+extern unsigned int		stream_drop;		// Frames not queued, TX ring full
+
+#endif /*STREAM_H_*/
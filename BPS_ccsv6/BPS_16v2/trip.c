@@ -0,0 +1,162 @@
+/*
+ * Protection trip and trip latency record
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - batt_KILL and batt_ERR are still set for the main loop, which sets the
+ *   indicators and enters ERRORMODE after the task that tripped returns
+ * - A fault that stays present trips again on every check, the first record
+ *   stays latched and the count keeps going
+ * - A filtered trip is recorded with the sample time of the first bad sample,
+ *   so the trip latency includes the time spent confirming it
+ * - Severe levels: a hard OV flag, over-current or over-temperature past the
+ *   class's severe excess (trip_scale), so the worst case reaction is one sample
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "trip.h"
+#include "relay.h"
+#include "probe.h"
+
+// Public variables
+trip_log				trip;
+trip_filter				trip_filt[TRIP_CLASSES];
+
+// Filter per fault class
+const trip_class		trip_classes[TRIP_CLASSES] =
+{
+	// type				n	m	limit
+	{ TRIP_NOFM,		2,	3,	0 },				// LTC1: PEC, config or UV in 2 of 3 status reads
+	{ TRIP_NOFM,		2,	3,	0 },				// LTC2
+	{ TRIP_NOFM,		2,	3,	0 },				// LTC3
+	{ TRIP_NOFM,		3,	6,	0 },				// Voltage read PEC errors, 3 of the last 6 reads (2 sweeps)
+	{ TRIP_INTEGRATE,	2,	0,	TRIP_INT_LIMIT },	// Discharge over-current, ~1 sec at the threshold
+	{ TRIP_INTEGRATE,	2,	0,	TRIP_INT_LIMIT },	// Charge over-current
+	{ TRIP_INTEGRATE,	1,	0,	TRIP_INT_LIMIT },	// Over-temperature
+	{ TRIP_NOFM,		3,	4,	0 },				// Open thermistor, 3 of 4 scans
+	{ TRIP_NOFM,		2,	3,	0 },				// Temperature rise, 2 of 3 trise cycles (~3 sec)
+	{ TRIP_NOFM,		2,	3,	0 },				// Pack voltage cross check, 2 of 3 LTC sweeps
+};
+
+// Private function prototypes
+static unsigned char	trip_bits( unsigned int v );
+
+/*
+ * Isolates the battery for fault err, the tripping data was sampled at t_sample (probe_time)
+ */
+void bps_trip( unsigned char err, unsigned long t_sample )
+{
+	extern volatile unsigned char batt_KILL;
+	extern volatile unsigned char batt_ERR;
+	extern volatile unsigned int tick_count;
+	unsigned long t_detect, latency;
+
+	t_detect = probe_time();
+	relay_open_all();
+
+	trip.last.t_open = probe_time();
+	trip.last.t_detect = t_detect;
+	trip.last.t_sample = t_sample;
+	trip.last.err = err;
+	trip.last.tick = tick_count;
+
+	batt_KILL = TRUE;
+	batt_ERR = err;
+
+	if( trip.count == 0 ) trip.first = trip.last;
+	if( trip.count != 0xFFFF ) trip.count++;
+	latency = trip.last.t_open - t_sample;
+	if( latency > trip.worst ){
+		trip.worst = latency;
+		trip.worst_err = err;
+	}
+}
+
+/*
+ * Unlatches the first trip and clears the counters, marginal sample counts included
+ */
+void trip_clear( void )
+{
+	unsigned char n;
+
+	for( n = 0; n < TRIP_CLASSES; n++ ) trip_filt[n].marginal = 0;
+	trip.count = 0;
+	trip.worst = 0;
+	trip.worst_err = 0x00;
+	trip.first.err = 0x00;
+	trip.last.err = 0x00;
+}
+
+/*
+ * One sample of fault class cls, trips with err (bps_trip) once the class filter confirms it
+ *	- level: TRIP_OK, a marginal weight (TRIP_MARGINAL for N of M), or TRIP_SEVERE
+ *	- Good samples must be passed too, they move the window / leak the integrator
+ */
+void trip_sample( unsigned char cls, unsigned char level, unsigned char err, unsigned long t_sample )
+{
+	const trip_class *c;
+	trip_filter *f;
+	unsigned char confirmed = FALSE;
+	unsigned int mask;
+
+	if( cls >= TRIP_CLASSES ) return;
+	c = &trip_classes[cls];
+	f = &trip_filt[cls];
+
+	if(( level != TRIP_OK ) && ( f->hist == 0 ) && ( f->acc == 0 )) f->t_first = t_sample;
+
+	if( level == TRIP_SEVERE ){
+		bps_trip( err, t_sample );
+		return;
+	}
+
+	if( c->type == TRIP_NOFM ){
+		mask = ( c->m >= 16 ) ? 0xFFFF : (( 1 << c->m ) - 1 );
+		f->hist = (( f->hist << 1 ) | ( level != TRIP_OK )) & mask;
+		if( trip_bits( f->hist ) >= c->n ) confirmed = TRUE;
+	}
+	else{
+		if( level != TRIP_OK ) f->acc += level;
+		else f->acc = ( f->acc > c->n ) ? ( f->acc - c->n ) : 0;
+		if( f->acc >= c->limit ){
+			confirmed = TRUE;
+			f->acc = c->limit;
+		}
+	}
+
+	if( confirmed ) bps_trip( err, f->t_first );
+	else if( level != TRIP_OK ) f->marginal++;
+}
+
+/*
+ * Integrator weight for an excess over a threshold: 1 just over it, rising to
+ * TRIP_SEVERE at the severe excess, so trip time falls as the excursion grows
+ */
+unsigned char trip_scale( unsigned long excess, unsigned long severe )
+{
+	if( excess >= severe ) return( TRIP_SEVERE );
+	return( 1 + (unsigned char)(( excess * ( TRIP_INT_LIMIT - 1 )) / severe ));
+}
+
+/*
+ * Clears every class filter (INITIALIZE)
+ */
+void trip_filter_reset( void )
+{
+	unsigned char n;
+
+	for( n = 0; n < TRIP_CLASSES; n++ ){
+		trip_filt[n].hist = 0;
+		trip_filt[n].acc = 0;
+	}
+}
+
+static unsigned char trip_bits( unsigned int v )
+{
+	unsigned char n;
+
+	for( n = 0; v != 0; v &= v - 1 ) n++;
+	return( n );
+}
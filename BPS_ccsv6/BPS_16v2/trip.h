@@ -0,0 +1,90 @@
+/*
+ * Protection trip and trip latency record
+ *
+ * Every protection check that isolates the battery calls bps_trip with its
+ * fault code and the probe_time() at which the tripping data was sampled.
+ * bps_trip commands the contactors open before it returns and records the
+ * sample, detection and contactor command times, so the end to end trip
+ * latency of each fault is a number (RS232 "fault show").
+ *
+ * Most checks go through trip_sample instead, which filters each fault class
+ * before it calls bps_trip: N of the last M samples bad, or an integrator of
+ * the excess over the threshold. A severe sample (TRIP_SEVERE) trips at once
+ * in every class, so filtering only delays the marginal readings.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef TRIP_H_
+#define TRIP_H_
+
+// Public function prototypes
+extern void		bps_trip( unsigned char err, unsigned long t_sample );
+extern void		trip_clear( void );
+extern void		trip_sample( unsigned char cls, unsigned char level, unsigned char err, unsigned long t_sample );
+extern unsigned char	trip_scale( unsigned long excess, unsigned long severe );
+extern void		trip_filter_reset( void );
+
+// Fault classes, index into the filter table in trip.c
+#define TRIP_LTC1				0			// LTC1 config / flags (0x11)
+#define TRIP_LTC2				1			// LTC2 config / flags (0x12)
+#define TRIP_LTC3				2			// LTC3 config / flags (0x13)
+#define TRIP_LTC_READ			3			// Cell voltage read PEC errors (0x20)
+#define TRIP_OC_DISCHARGE		4			// Discharge over-current (0x30)
+#define TRIP_OC_CHARGE			5			// Charge over-current (0x40)
+#define TRIP_OVERTEMP			6			// Cell over-temperature (0x50)
+#define TRIP_TEMP_SENSOR		7			// Open thermistor (0x60)
+#define TRIP_TRISE				8			// Cell temperature rate of rise (0x51)
+#define TRIP_PACKV				9			// LTC cell sum against SIG1 (0x80)
+#define TRIP_CLASSES			10
+
+// Sample levels: 0 good, 1..TRIP_SEVERE-1 marginal (integrator weight), TRIP_SEVERE trips now
+#define TRIP_OK					0
+#define TRIP_MARGINAL			1
+#define TRIP_SEVERE				255
+
+// Filter types
+#define TRIP_NOFM				0			// N bad of the last M samples (M <= 16)
+#define TRIP_INTEGRATE			1			// Sum of the levels, less leak per good sample, reaches limit
+#define TRIP_INT_LIMIT			16			// Integrator limit used with trip_scale: 1..15 per marginal sample
+
+typedef struct _trip_class
+{
+  unsigned char		type;				// TRIP_NOFM or TRIP_INTEGRATE
+  unsigned char		n;					// NOFM: bad samples to trip, INTEGRATE: leak per good sample
+  unsigned char		m;					// NOFM: window, INTEGRATE: unused
+  unsigned int		limit;				// INTEGRATE: trip level, NOFM: unused
+} trip_class;
+
+typedef struct _trip_filter
+{
+  unsigned int		hist;				// NOFM: last M samples, bit 0 newest
+  unsigned int		acc;				// INTEGRATE: accumulated level
+  unsigned long		t_first;			// Sample time of the first bad sample since the filter was clear
+  unsigned int		marginal;			// Marginal samples filtered out (did not trip)
+} trip_filter;
+
+typedef struct _trip_event
+{
+  unsigned char		err;				// batt_ERR fault code
+  unsigned int		tick;				// tick_count at detection
+  unsigned long		t_sample;			// probe_time() of the tripping measurement
+  unsigned long		t_detect;			// probe_time() at bps_trip
+  unsigned long		t_open;				// probe_time() after the MC/precharge contactors were opened
+} trip_event;
+
+typedef struct _trip_log
+{
+  trip_event		first;				// Latched, first trip since trip_clear
+  trip_event		last;				// Most recent trip
+  unsigned int		count;				// Trips since trip_clear (repeats of a standing fault included)
+  unsigned long		worst;				// Longest t_open - t_sample (us)
+  unsigned char		worst_err;			// Fault code of the worst
+} trip_log;
+
+extern trip_log		trip;
+extern trip_filter	trip_filt[TRIP_CLASSES];
+extern const trip_class	trip_classes[TRIP_CLASSES];
+
+#endif /*TRIP_H_*/
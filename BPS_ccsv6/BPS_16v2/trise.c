@@ -0,0 +1,90 @@
+/*
+ * Temperature rate of rise per sensor
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - trise_update runs in the measure task after the thermistor scan, each
+ *   sensor costs a conversion and a filter step per scan, and a ring step
+ *   once every TRISE_DECIM scans (sensor n steps on scan n % TRISE_DECIM)
+ * - The cycle (all sensors stepped once) ends on scan TRISE_DECIM - 1, which
+ *   is when the fault class gets its sample and the status is updated
+ * - A sensor's rate only counts once its ring holds TRISE_HIST real steps
+ * - One bad reading moves the filter for a few scans only, so it can put a
+ *   single cycle over TRISE_SEVERE_CPM but not two: that cycle only counts
+ *   as MARGINAL for the trip filter
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "trise.h"
+#include "limits.h"
+#include "trip.h"
+
+// Public variables
+trise_state				trise;
+
+/*
+ * One thermistor scan, t_sample is the probe_time() of the scan
+ */
+void trise_update( unsigned long t_sample )
+{
+	extern volatile unsigned long temperature_adc[40];
+	unsigned char n, k;
+	unsigned char level;
+	int t, rate, max_cell;
+
+	for( n = TRISE_FIRST; n < TRISE_SENSORS; n++ ){
+		if( temperature_adc[n] >= MIN_TEMP_NOSENSOR ){		// Open, reseed when it returns
+			trise.age[n] = 0;
+			trise.rate[n] = 0;
+			continue;
+		}
+		t = ADC_TO_CENTI_C( temperature_adc[n] );
+		if( trise.age[n] == 0 ){
+			trise.filt[n] = t;
+			for( k = 0; k < TRISE_HIST; k++ ) trise.hist[n][k] = t;
+			trise.age[n] = 1;
+		}
+		trise.filt[n] += ( t - trise.filt[n] ) >> TRISE_FILTER_SHIFT;
+
+		if(( n & ( TRISE_DECIM - 1 )) != trise.scan ) continue;
+		rate = (int) TRISE_WINDOW_TO_CPM( trise.filt[n] - trise.hist[n][trise.head] );
+		trise.hist[n][trise.head] = trise.filt[n];
+		if( trise.age[n] < TRISE_HIST ) trise.age[n]++;
+		else trise.rate[n] = rate;
+	}
+
+	if( ++trise.scan < TRISE_DECIM ) return;
+	trise.scan = 0;
+	if( ++trise.head >= TRISE_HIST ) trise.head = 0;
+
+	// End of a cycle: every sensor has a fresh rate
+	trise.max_rate = -32767;
+	max_cell = -32767;
+	for( n = TRISE_FIRST; n < TRISE_SENSORS; n++ ){
+		rate = trise.rate[n];
+		if( rate > trise.max_rate ){
+			trise.max_rate = rate;
+			trise.max_idx = n;
+		}
+		if(( n >= PACK_TEMP_FIRST ) && ( n <= PACK_TEMP_LAST ) && ( rate > max_cell )) max_cell = rate;
+	}
+
+	if( trise.max_rate >= TRISE_WARN_CPM ){
+		if(( trise.status & TRISE_WARN ) == 0x00 ) trise.warn_cnt++;
+		trise.status |= TRISE_WARN;
+	}
+	else trise.status &= ~TRISE_WARN;
+
+	if( max_cell >= TRISE_TRIP_CPM ) trise.status |= TRISE_OVER;
+	else trise.status &= ~TRISE_OVER;
+
+	if( max_cell < TRISE_SEVERE_CPM ) trise.severe_cnt = 0;
+	else if( trise.severe_cnt < TRISE_SEVERE_CYCLES ) trise.severe_cnt++;
+
+	if( trise.severe_cnt >= TRISE_SEVERE_CYCLES ) level = TRIP_SEVERE;
+	else if( max_cell >= TRISE_TRIP_CPM ) level = TRIP_MARGINAL;
+	else level = TRIP_OK;
+	trip_sample( TRIP_TRISE, level, 0x51, t_sample );
+}
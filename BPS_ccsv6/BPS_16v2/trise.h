@@ -0,0 +1,64 @@
+/*
+ * Temperature rate of rise per sensor
+ *
+ * Each thermistor reading is converted to centi-degrees C and low pass
+ * filtered. Once per TRISE_DECIM scans the filtered value goes into a short
+ * ring per sensor, and the rise over the ring (TRISE_HIST steps) is the
+ * sensor's dT/dt. The ring steps are staggered across the sensors, so each
+ * scan only steps a few of them. A cell sensor rising faster than
+ * TRISE_TRIP_CPM trips (filtered as its own fault class, 0x51) well before
+ * it reaches the absolute MAX_TEMP limit, and over TRISE_SEVERE_CPM for
+ * TRISE_SEVERE_CYCLES cycles in a row it trips at once; any sensor over
+ * TRISE_WARN_CPM is reported on BP_TRISE. A sensor reading open
+ * (MIN_TEMP_NOSENSOR) is reseeded when it comes back.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef TRISE_H_
+#define TRISE_H_
+
+// Public function prototypes
+extern void		trise_update( unsigned long t_sample );
+
+// Sensors: temperature_adc[1..39], cells are PACK_TEMP_FIRST..PACK_TEMP_LAST
+#define TRISE_FIRST				1
+#define TRISE_SENSORS			40
+
+// History
+#define TRISE_FILTER_SHIFT		2			// IIR on the readings, new sample weight 1/4
+#define TRISE_DECIM				16			// Scans per ring step (~1 sec at the measure task rate), power of 2
+#define TRISE_HIST				8			// Ring steps, rate window ~7.7 sec
+
+// Rise over the ring (centi-C) to centi-C per minute: 60000 / ( TRISE_HIST * TRISE_DECIM * 60 ms ) = 125 / 16
+#define TRISE_WINDOW_TO_CPM(d)	(((long)(d) * 125L) >> 4)
+
+// Rate limits (centi-C per minute)
+#define TRISE_WARN_CPM			300			// 3 C/min, early warning
+#define TRISE_TRIP_CPM			1000		// 10 C/min on a cell, trips when confirmed
+#define TRISE_SEVERE_CPM		3000		// 30 C/min, trips at once when held
+#define TRISE_SEVERE_CYCLES		2			// Cycles in a row over TRISE_SEVERE_CPM before it counts
+
+// Status bits (trise.status)
+#define TRISE_WARN				0x01		// A sensor over TRISE_WARN_CPM
+#define TRISE_OVER				0x02		// A cell sensor over TRISE_TRIP_CPM
+
+typedef struct _trise_state
+{
+  int				filt[TRISE_SENSORS];				// Filtered temperature (centi-C)
+  int				hist[TRISE_SENSORS][TRISE_HIST];	// Ring of filt, one entry per ring step
+  int				rate[TRISE_SENSORS];				// Latest dT/dt (centi-C per minute)
+  unsigned char		age[TRISE_SENSORS];					// Ring steps since seeded, saturates at TRISE_HIST
+  unsigned char		head;					// Ring entry this cycle's steps write
+  unsigned char		scan;					// Scans mod TRISE_DECIM
+  unsigned char		max_idx;				// Sensor with the highest rate this cycle
+  int				max_rate;				// Its rate (centi-C per minute)
+  unsigned char		severe_cnt;				// Cycles in a row with a cell over TRISE_SEVERE_CPM
+  unsigned char		status;
+  unsigned int		warn_cnt;				// Transitions into TRISE_WARN
+} trise_state;
+
+extern trise_state		trise;
+
+#endif /*TRISE_H_*/
@@ -0,0 +1,175 @@
+/*
+ * Shunt zero offset
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ * - zero_sample runs in the measure task on the uncorrected shunt code, only
+ *   while every contactor is open and settled, with the misc ADC temperature
+ *   read in the same run
+ * - A window is dropped when a reading is over ZERO_MAX_CODE (current is
+ *   flowing, a contactor may be welded) or its spread is over ZERO_SPREAD_CODE
+ * - zero_track runs before each shunt_read of the measure task, the offset
+ *   only moves with the temperature or a new window
+ * - Info flash: the first measurement of a bin is written at once, later
+ *   changes over ZERO_SAVE_CODE at most once per ZERO_SAVE_MIN_TICKS, each
+ *   write is a segment erase (~25 ms with the CPU held). The windows only run
+ *   with the contactors open, so no write happens while driving. A write
+ *   that fails its read back is not retried until the next reset
+ *
+ */
+
+// Include files
+#include "BPSmain.h"
+#include "zero.h"
+#include "limits.h"
+#include "flash.h"
+
+// Public variables
+zero_state				zero;
+
+// Private function prototypes
+static int				zero_temp( unsigned long t_code );
+static long				zero_interp( int t );
+static void				zero_save( void );
+
+/*
+ * Loads the offset table from info flash B, at reset
+ *	- A blank or corrupt table leaves no bin measured (offset 0)
+ */
+void zero_init( void )
+{
+	const zero_table *f = (const zero_table *) ZERO_FLASH_ADDR;
+	unsigned char n;
+
+	zero.status = 0x00;
+	if(( f->tag == ZERO_FLASH_TAG ) && ( f->check == flash_check( f, ZERO_CHECK_WORDS ))){
+		zero.table = *f;
+		zero.status |= ZERO_FROM_FLASH;
+	}
+	else{
+		zero.table.tag = ZERO_FLASH_TAG;
+		zero.table.valid = 0x0000;
+		for( n = 0; n < ZERO_BINS; n++ ) zero.table.offset[n] = 0;
+	}
+	zero.count = 0;
+	zero_track( MIN_TEMP_NOSENSOR );
+}
+
+/*
+ * One shunt reading at zero current, t_code is the misc ADC temperature code
+ */
+void zero_sample( long code, unsigned long t_code )
+{
+	extern volatile unsigned int tick_count;
+	const zero_table *f = (const zero_table *) ZERO_FLASH_ADDR;
+	unsigned char n;
+	unsigned int bit;
+	long avg, d;
+
+	if(( tick_count - zero.last_tick ) > ZERO_GAP_TICKS ) zero.count = 0;
+	zero.last_tick = tick_count;
+
+	if(( code > ZERO_MAX_CODE ) || ( code < -ZERO_MAX_CODE )){
+		zero.count = 0;
+		zero.rejects++;
+		return;
+	}
+	if( zero.count == 0 ){
+		zero.sum = 0;
+		zero.min = code;
+		zero.max = code;
+	}
+	zero.sum += code;
+	if( code < zero.min ) zero.min = code;
+	if( code > zero.max ) zero.max = code;
+	if( ++zero.count < ZERO_SAMPLES ) return;
+
+	// End of a window
+	zero.count = 0;
+	if(( zero.max - zero.min ) > ZERO_SPREAD_CODE ){
+		zero.rejects++;
+		return;
+	}
+	avg = zero.sum >> ZERO_SAMPLES_SHIFT;
+	n = (unsigned char)( zero_temp( t_code ) / ZERO_BIN_CC );
+	bit = 1 << n;
+	if( zero.table.valid & bit ) zero.table.offset[n] += ( avg - zero.table.offset[n] ) >> ZERO_FILTER_SHIFT;
+	else{
+		zero.table.offset[n] = avg;
+		zero.table.valid |= bit;
+	}
+	zero.windows++;
+	zero_track( t_code );
+
+	if( zero.status & ZERO_FLASH_FAIL ) return;			// RAM table only until reset
+	if(( f->tag != ZERO_FLASH_TAG ) || ( f->check != flash_check( f, ZERO_CHECK_WORDS )) || (( f->valid & bit ) == 0x0000 )){
+		zero_save();							// bin not in flash yet
+		return;
+	}
+	d = zero.table.offset[n] - f->offset[n];
+	if(( d > ZERO_SAVE_CODE ) || ( d < -ZERO_SAVE_CODE )) zero.status |= ZERO_DIRTY;
+	if(( zero.status & ZERO_DIRTY ) && (( tick_count - zero.save_tick ) >= ZERO_SAVE_MIN_TICKS )) zero_save();
+}
+
+/*
+ * Offset for the misc ADC temperature code t_code, applied from here on
+ */
+void zero_track( unsigned long t_code )
+{
+	zero.t_cc = zero_temp( t_code );
+	zero.offset = zero_interp( zero.t_cc );
+}
+
+/*
+ * Temperature (centi-C) clamped to the bin range, ZERO_T_OPEN_CC for an open sensor
+ */
+static int zero_temp( unsigned long t_code )
+{
+	int t;
+
+	if( t_code >= MIN_TEMP_NOSENSOR ) return( ZERO_T_OPEN_CC );
+	t = ADC_TO_CENTI_C( t_code );
+	if( t < 0 ) return( 0 );
+	if( t >= ZERO_BINS * ZERO_BIN_CC ) return( ZERO_BINS * ZERO_BIN_CC - 1 );
+	return( t );
+}
+
+/*
+ * Linear between the measured bins either side of t (bin centres), the
+ * nearest one beyond the last, 0 with none measured
+ */
+static long zero_interp( int t )
+{
+	signed char n, lo = -1, hi = -1;
+	int c_lo, c_hi;
+	long d;
+
+	for( n = 0; n < ZERO_BINS; n++ ){
+		if(( zero.table.valid & ( 1 << n )) == 0x0000 ) continue;
+		if(( n * ZERO_BIN_CC + ZERO_BIN_CC / 2 ) <= t ) lo = n;
+		else if( hi < 0 ) hi = n;
+	}
+	if( lo < 0 ) return(( hi < 0 ) ? 0 : zero.table.offset[hi] );
+	if( hi < 0 ) return( zero.table.offset[lo] );
+
+	c_lo = lo * ZERO_BIN_CC + ZERO_BIN_CC / 2;
+	c_hi = hi * ZERO_BIN_CC + ZERO_BIN_CC / 2;
+	d = zero.table.offset[hi] - zero.table.offset[lo];
+	return( zero.table.offset[lo] + ( d * (( t - c_lo ) / 10 )) / (( c_hi - c_lo ) / 10 ));
+}
+
+/*
+ * Writes the RAM table to info flash B
+ *	- A write that does not read back sets ZERO_FLASH_FAIL, no more writes are tried
+ */
+static void zero_save( void )
+{
+	extern volatile unsigned int tick_count;
+
+	zero.table.tag = ZERO_FLASH_TAG;
+	zero.table.check = flash_check( &zero.table, ZERO_CHECK_WORDS );
+	if( !flash_write( (void *) ZERO_FLASH_ADDR, &zero.table, sizeof( zero_table ) / 2, TRUE )) zero.status |= ZERO_FLASH_FAIL;
+	zero.status &= ~ZERO_DIRTY;
+	zero.save_tick = tick_count;
+	zero.saves++;
+}
@@ -0,0 +1,79 @@
+/*
+ * Shunt zero offset
+ *
+ * The shunt current is the misc ADC code diff_shunt - diff_ref, which also
+ * carries the offset of the shunt amplifier and the ADC. While every
+ * contactor is open (SELFCHECK, ERRORMODE) no current flows, so that code is
+ * the offset: ZERO_SAMPLES readings are averaged into a window, and a quiet
+ * window updates the offset of the bin of the misc ADC temperature it was
+ * taken at. shunt_read subtracts the offset interpolated between the measured
+ * bins at the present temperature, so the limits, I2t, SOC and resistance
+ * estimates all see the corrected current. The bins are kept in info flash
+ * segment B across resets.
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#ifndef ZERO_H_
+#define ZERO_H_
+
+// Public function prototypes
+extern void				zero_init( void );
+extern void				zero_sample( long code, unsigned long t_code );
+extern void				zero_track( unsigned long t_code );
+
+// Window
+#define ZERO_SAMPLES_SHIFT		4			// 16 readings, ~1 sec at the measure task rate
+#define ZERO_SAMPLES			(1 << ZERO_SAMPLES_SHIFT)
+#define ZERO_GAP_TICKS			(2 * LTC_STATUS_COUNT)	// Longer between readings restarts the window
+#define ZERO_MAX_CODE			125000L		// |code| limit, ~1 A: more is current, not offset
+#define ZERO_SPREAD_CODE		25000L		// Window max - min limit, ~0.2 A
+#define ZERO_FILTER_SHIFT		2			// Bin update weight 1/4 once measured
+
+// Temperature bins (misc ADC temperature, centi-C)
+#define ZERO_BINS				8
+#define ZERO_BIN_CC				800			// 8 C per bin, bin 0 from 0 C
+#define ZERO_T_OPEN_CC			2500		// Used while the sensor reads open
+
+// Info flash
+#define ZERO_FLASH_ADDR			0x1900		// INFOB
+#define ZERO_FLASH_TAG			0x2E50
+#define ZERO_SAVE_CODE			6000L		// ~50 mA, bin change that is worth a write
+#define ZERO_SAVE_MIN_TICKS		(300 * TICK_RATE)	// And at least this long since the last write
+
+// Status bits (zero.status)
+#define ZERO_FROM_FLASH			0x01		// Table restored at reset
+#define ZERO_DIRTY				0x02		// RAM table differs from flash
+#define ZERO_FLASH_FAIL			0x04		// A write did not read back, no more are tried
+
+typedef struct _zero_table
+{
+  unsigned int		tag;				// ZERO_FLASH_TAG
+  unsigned int		valid;				// Bit per bin with a measured offset
+  long				offset[ZERO_BINS];	// Shunt code at zero current
+  unsigned int		check;				// ~sum of the words above
+} zero_table;
+
+#define ZERO_CHECK_WORDS		(( sizeof( zero_table ) / 2 ) - 1)	// Words under check
+
+typedef struct _zero_state
+{
+  zero_table		table;
+  long				offset;				// Applied by shunt_read
+  int				t_cc;				// Temperature it was interpolated at
+  long				sum;				// Window so far
+  long				min;
+  long				max;
+  unsigned char		count;
+  unsigned int		last_tick;			// tick_count of the last reading
+  unsigned int		save_tick;			// tick_count of the last flash write
+  unsigned int		windows;			// Windows used
+  unsigned int		rejects;			// Readings over ZERO_MAX_CODE and noisy windows
+  unsigned int		saves;				// Flash writes since reset
+  unsigned char		status;
+} zero_state;
+
+extern zero_state		zero;
+
+#endif /*ZERO_H_*/
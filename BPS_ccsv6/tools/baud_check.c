@@ -0,0 +1,114 @@
+/*
+ * Host check of the UCA3 baud rate macros in BPS_16v2/RS232.h
+ *
+ * Built once per clock and rate, the same symbols as the CCS project:
+ *
+ *	cc -DSMCLK_RATE=8000000L -DPC_BAUD=115200L -I../BPS_16v2 -o baud_check baud_check.c
+ *	./baud_check
+ *
+ * - Decodes PC_UCBR / PC_UCMCTL as the USCI does (user's guide 34.3.10) and
+ *   checks PC_T0..PC_T9 against that bit timing
+ * - Searches every UCBRx / UCBRFx / UCBRSx / UCOS16 setting for the smallest
+ *   worst bit error over a 10 bit character, the macros must be within
+ *   BEST_SLACK of it
+ * - Exit status 0 when both hold and the error is within PC_MAX_ERR, as the
+ *   #error check in RS232.c
+ *
+ * 2015 Western Michigan University Sunseeker
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "RS232.h"
+
+#define BITS			10				// Start, 8 data, stop
+#define BEST_SLACK		10				// 0.1% of a bit, round(frac(N) * 8) is not always the best UCBRSx
+
+// UCBRSx patterns (bit 7 = start bit), table 34-2
+static const unsigned char brs_pat[8] = { 0x00, 0x40, 0x44, 0x54, 0x55, 0x75, 0x77, 0x7F };
+
+/*
+ * Clocks of bit k with the given setting
+ *	- UCOS16 = 0: UCBRx, plus one on the UCBRSx bits
+ *	- UCOS16 = 1: 16 BITCLK16 periods of UCBRx, UCBRFx of them one clock longer
+ *	  (table 34-3), plus one BITCLK16 (UCBRx clocks) on the UCBRSx bits
+ */
+static long bit_clocks( long ucbr, int ucbrf, int ucbrs, int os16, int k )
+{
+	int m = ( brs_pat[ucbrs] >> ( 7 - ( k % 8 ))) & 1;
+
+	if( os16 == 0 ) return( ucbr + m );
+	return(( 16 + m ) * ucbr + ucbrf );
+}
+
+static long bit_err( long t, long n )
+{
+	return( PC_BIT_ERR( t, n ));
+}
+
+// Worst |error| over a character, 0.01% of a bit
+static long char_err( long ucbr, int ucbrf, int ucbrs, int os16 )
+{
+	long t = 0, e, worst = 0;
+	int k;
+
+	for( k = 0; k < BITS; k++ ){
+		t += bit_clocks( ucbr, ucbrf, ucbrs, os16, k );
+		e = labs( bit_err( t, k + 1 ));
+		if( e > worst ) worst = e;
+	}
+	return( worst );
+}
+
+int main( void )
+{
+	const long pc_t[BITS] = { PC_T0, PC_T1, PC_T2, PC_T3, PC_T4, PC_T5, PC_T6, PC_T7, PC_T8, PC_T9 };
+	long ucbr = PC_UCBR, b, t = 0, worst, best = -1, best_ucbr = 0;
+	int mctl = PC_UCMCTL, os16 = mctl & 1, ucbrf = ( mctl >> 4 ) & 0x0F, ucbrs = ( mctl >> 1 ) & 0x07;
+	int f, s, o, k, best_f = 0, best_s = 0, best_o = 0, fail = 0;
+
+	printf( "%ld Hz, %ld bit/s: UCBRx %ld, UCBRFx %d, UCBRSx %d, UCOS16 %d\n",
+			(long) PC_CLK_RATE, (long) PC_BAUD, ucbr, ucbrf, ucbrs, os16 );
+
+	for( k = 0; k < BITS; k++ ){
+		t += bit_clocks( ucbr, ucbrf, ucbrs, os16, k );
+		if( t != pc_t[k] ){
+			printf( "PC_T%d %ld, USCI %ld\n", k, pc_t[k], t );
+			fail = 1;
+		}
+	}
+	worst = char_err( ucbr, ucbrf, ucbrs, os16 );
+
+	for( o = 0; o < 2; o++ ){
+		for( b = 1; b <= 0xFFFF; b++ ){
+			if(( o == 0 ) && ( b < 3 )) continue;
+			if(( o == 1 ) && ( b * 16 > PC_CLK_RATE / PC_BAUD + 16 )) break;
+			if(( o == 0 ) && ( b > PC_CLK_RATE / PC_BAUD + 1 )) break;
+			for( f = 0; f < (( o == 1 ) ? 16 : 1 ); f++ ){
+				for( s = 0; s < 8; s++ ){
+					long e = char_err( b, f, s, o );
+					if(( best < 0 ) || ( e < best )){
+						best = e;
+						best_ucbr = b;
+						best_f = f;
+						best_s = s;
+						best_o = o;
+					}
+				}
+			}
+		}
+	}
+
+	printf( "worst bit error %ld.%02ld%%, best %ld.%02ld%% (UCBRx %ld, UCBRFx %d, UCBRSx %d, UCOS16 %d)\n",
+			worst / 100, worst % 100, best / 100, best % 100, best_ucbr, best_f, best_s, best_o );
+	if( worst > best + BEST_SLACK ){
+		printf( "macros %ld over the best setting\n", worst - best );
+		fail = 1;
+	}
+	if( worst > PC_MAX_ERR ){
+		printf( "over PC_MAX_ERR, RS232.c stops the build\n" );
+		fail = 1;
+	}
+	return( fail );
+}
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+"""
+BPS binary telemetry decoder
+
+Reads the COBS framed stream enabled with the "stream on [n]" RS232 command
+(frame layout in BPS_16v2/stream.h) and writes one CSV row per frame.
+
+    python3 bps_stream.py COM5 --baud 38400 -o log.csv
+    python3 bps_stream.py capture.bin -o log.csv        (raw capture file)
+
+Needs pyserial for a serial port. Frames that fail the length or CRC check
+are counted and skipped; text output from the BPS between frames is ignored.
+"""
+
+import argparse
+import struct
+import sys
+
+VERSION = 0x01
+RAW_SIZE = 206
+CELLS = 35
+TEMPS = 40
+
+# version, seq, timestamp, 35 cell codes; temperatures are 24 bit and unpacked separately
+HEAD = struct.Struct('<BHI%dH' % CELLS)
+TAIL = struct.Struct('<iBBBH')
+TEMP_OFFSET = HEAD.size
+TAIL_OFFSET = TEMP_OFFSET + 3 * TEMPS
+assert TAIL_OFFSET + TAIL.size == RAW_SIZE
+
+
+def crc16_table():
+    table = []
+    for i in range(256):
+        c = i << 8
+        for _ in range(8):
+            c = ((c << 1) ^ 0x1021) if c & 0x8000 else (c << 1)
+        table.append(c & 0xFFFF)
+    return table
+
+
+CRC_TABLE = crc16_table()
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc = ((crc << 8) & 0xFFFF) ^ CRC_TABLE[(crc >> 8) ^ b]
+    return crc
+
+
+def cobs_decode(data):
+    out = bytearray()
+    i = 0
+    n = len(data)
+    while i < n:
+        code = data[i]
+        if code == 0 or i + code > n:
+            return None
+        out += data[i + 1:i + code]
+        i += code
+        if code < 0xFF and i < n:
+            out.append(0)
+    return bytes(out)
+
+
+def decode_frame(raw):
+    """Returns a dict for a valid frame, None otherwise."""
+    if len(raw) != RAW_SIZE or raw[0] != VERSION:
+        return None
+    if crc16(raw[:-2]) != struct.unpack_from('<H', raw, RAW_SIZE - 2)[0]:
+        return None
+    head = HEAD.unpack_from(raw, 0)
+    t = raw[TEMP_OFFSET:TAIL_OFFSET]
+    temps = [t[k] | (t[k + 1] << 8) | (t[k + 2] << 16) for k in range(0, 3 * TEMPS, 3)]
+    current, mode, fault, flags, _ = TAIL.unpack_from(raw, TAIL_OFFSET)
+    return {
+        'seq': head[1],
+        'tick': head[2],
+        'cells': head[3:],
+        'temps': temps,
+        'current': current,
+        'mode': mode,
+        'fault': fault,
+        'flags': flags,
+    }
+
+
+def cell_volts(code):
+    return (code - 512) * 0.0015
+
+
+def temp_c(code):
+    return 126.1575 - 311.329 * (code / 16777216.0)
+
+
+def csv_header():
+    cols = ['seq', 'time_s', 'current_A', 'mode', 'fault', 'flags']
+    cols += ['v%d' % n for n in range(CELLS)]
+    cols += ['t%d' % n for n in range(TEMPS)]
+    return ','.join(cols)
+
+
+def csv_row(f):
+    vals = [str(f['seq']), '%.2f' % (f['tick'] * 0.01), '%.3f' % (f['current'] * 0.001),
+            str(f['mode']), '0x%02X' % f['fault'], str(f['flags'])]
+    vals += ['%.4f' % cell_volts(c) for c in f['cells']]
+    vals += ['%.2f' % temp_c(c) for c in f['temps']]
+    return ','.join(vals)
+
+
+def open_source(name, baud):
+    try:
+        return open(name, 'rb'), False
+    except OSError:
+        import serial  # pyserial
+        return serial.Serial(name, baud, timeout=0.5), True
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('source', help='serial port or capture file')
+    ap.add_argument('--baud', type=int, default=38400)
+    ap.add_argument('-o', '--output', help='CSV file (default stdout)')
+    args = ap.parse_args()
+
+    src, is_port = open_source(args.source, args.baud)
+    out = open(args.output, 'w') if args.output else sys.stdout
+    out.write(csv_header() + '\n')
+
+    good = bad = lost = text = 0
+    last_seq = None
+    pending = b''
+    try:
+        while True:
+            chunk = src.read(4096) if not is_port else src.read(max(1, src.in_waiting))
+            if not chunk:
+                if is_port:
+                    continue
+                break
+            pending += chunk
+            parts = pending.split(b'\x00')
+            pending = parts.pop()
+            for part in parts:
+                if not part:
+                    continue
+                if all(32 <= b < 127 or b in (10, 13) for b in part):
+                    text += 1
+                    continue
+                raw = cobs_decode(part)
+                frame = decode_frame(raw) if raw is not None else None
+                if frame is None:
+                    bad += 1
+                    continue
+                if last_seq is not None:
+                    lost += (frame['seq'] - last_seq - 1) & 0xFFFF
+                last_seq = frame['seq']
+                good += 1
+                out.write(csv_row(frame) + '\n')
+    except KeyboardInterrupt:
+        pass
+    finally:
+        if out is not sys.stdout:
+            out.close()
+        sys.stderr.write('frames %d, bad %d, lost %d, text lines %d\n' % (good, bad, lost, text))
+
+
+if __name__ == '__main__':
+    main()